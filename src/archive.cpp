@@ -0,0 +1,255 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "archive.hpp"
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+static constexpr char magic[8] = {'Q', 'C', 'A', 'A', 'R', 'C', 'H', '\0'};
+static constexpr uint32_t version = 1;
+static constexpr std::size_t header_size = 64;
+
+struct header {
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint8_t code;
+  uint8_t edges;
+  uint8_t init;
+  uint8_t zero;
+  uint32_t rows_per_chunk;
+  uint64_t seed;
+  uint64_t rows;
+  uint64_t index_offset;
+  uint8_t reserved[16];
+};
+
+static_assert(sizeof(header) == header_size, "archive header is 64 bytes");
+
+static std::size_t words_for(const int width) {
+  return (width + 63) / 64;
+}
+
+qca::archive_writer::archive_writer(
+  const std::string &path, const archive_info &info,
+  const uint32_t rows_per_chunk
+) : file(path, std::ios::binary), info(info),
+    rows_per_chunk(std::max<uint32_t>(rows_per_chunk, 1)),
+    row_words(words_for(info.width)) {
+  this->info.rows = 0;
+  chunk.resize(this->rows_per_chunk * row_words);
+  write_header(0);
+}
+
+qca::archive_writer::~archive_writer() {
+  finish();
+}
+
+bool qca::archive_writer::good() const {
+  return file.good();
+}
+
+void qca::archive_writer::push(const packed_generation &g) {
+  if (finished) { return; }
+
+  const auto row = chunk.begin() + chunk_rows * row_words;
+  std::copy_n(g.words.begin(), row_words, row);
+  chunk_rows++;
+  info.rows++;
+
+  if (chunk_rows == rows_per_chunk) {
+    write_chunk();
+  }
+}
+
+uint64_t qca::archive_writer::size() const {
+  return info.rows;
+}
+
+bool qca::archive_writer::finish() {
+  if (finished) { return good(); }
+  finished = true;
+
+  if (chunk_rows > 0) {
+    write_chunk();
+  }
+
+  const uint64_t index_offset = file.tellp();
+  file.write(
+    reinterpret_cast<const char *>(offsets.data()),
+    offsets.size() * sizeof(uint64_t)
+  );
+
+  write_header(index_offset);
+  file.close();
+
+  return !file.fail();
+}
+
+void qca::archive_writer::write_chunk() {
+  offsets.push_back(file.tellp());
+  file.write(
+    reinterpret_cast<const char *>(chunk.data()),
+    chunk_rows * row_words * sizeof(uint64_t)
+  );
+  chunk_rows = 0;
+}
+
+void qca::archive_writer::write_header(const uint64_t index_offset) {
+  header h{};
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.version = version;
+  h.width = info.width;
+  h.code = info.code;
+  h.edges = static_cast<uint8_t>(info.edges);
+  h.init = static_cast<uint8_t>(info.init);
+  h.rows_per_chunk = rows_per_chunk;
+  h.seed = info.seed;
+  h.rows = info.rows;
+  h.index_offset = index_offset;
+
+  const auto at = file.tellp();
+  file.seekp(0);
+  file.write(reinterpret_cast<const char *>(&h), sizeof(h));
+  if (at > 0) {
+    file.seekp(at);
+  }
+}
+
+qca::archive_reader::archive_reader(const std::string &path)
+: file(path, std::ios::binary) {
+  header h{};
+  if (!file.read(reinterpret_cast<char *>(&h), sizeof(h))) { return; }
+  if (std::memcmp(h.magic, magic, sizeof(magic)) != 0) { return; }
+  if (h.version != version || h.rows_per_chunk == 0) { return; }
+  // the enums are cast straight from these, so anything past their last
+  // value is a corrupt file
+  if (h.edges > static_cast<uint8_t>(boundary::reflect)) { return; }
+  if (h.init > static_cast<uint8_t>(init_mode::random)) { return; }
+
+  info.width = h.width;
+  info.code = h.code;
+  info.edges = static_cast<boundary>(h.edges);
+  info.init = static_cast<init_mode>(h.init);
+  info.seed = h.seed;
+  rows_per_chunk = h.rows_per_chunk;
+  row_words = words_for(info.width);
+
+  const std::size_t row_bytes = row_words * sizeof(uint64_t);
+  const std::size_t chunk_bytes = rows_per_chunk * row_bytes;
+
+  if (h.index_offset != 0) {
+    info.rows = h.rows;
+    offsets.resize((h.rows + rows_per_chunk - 1) / rows_per_chunk);
+    file.seekg(h.index_offset);
+    file.read(
+      reinterpret_cast<char *>(offsets.data()),
+      offsets.size() * sizeof(uint64_t)
+    );
+    if (!file) { return; }
+  } else {
+    // never finished: whole rows after the header, chunks back to back
+    file.seekg(0, std::ios::end);
+    const std::size_t data = std::size_t(file.tellg()) - header_size;
+    info.rows = row_bytes ? data / row_bytes : 0;
+
+    for (std::size_t at = 0; at < info.rows * row_bytes; at += chunk_bytes) {
+      offsets.push_back(header_size + at);
+    }
+  }
+
+  chunk.resize(rows_per_chunk * row_words);
+  ok = true;
+}
+
+bool qca::archive_reader::good() const {
+  return ok;
+}
+
+const qca::archive_info &qca::archive_reader::get_info() const {
+  return info;
+}
+
+uint64_t qca::archive_reader::size() const {
+  return info.rows;
+}
+
+qca::packed_generation qca::archive_reader::at(const uint64_t n) {
+  packed_generation p{info.width, std::vector<uint64_t>(row_words, 0)};
+
+  if (chunk_index == n / rows_per_chunk) {
+    const auto row = chunk.begin() + (n % rows_per_chunk) * row_words;
+    std::copy_n(row, row_words, p.words.begin());
+    return p;
+  }
+
+  // a single row does not need its whole chunk
+  const std::size_t row_bytes = row_words * sizeof(uint64_t);
+  file.clear();
+  file.seekg(offsets[n / rows_per_chunk] + (n % rows_per_chunk) * row_bytes);
+  file.read(reinterpret_cast<char *>(p.words.data()), row_bytes);
+
+  return p;
+}
+
+std::vector<qca::packed_generation> qca::archive_reader::window(
+  const uint64_t first, const uint64_t count, const int left, const int width
+) {
+  std::vector<packed_generation> rows;
+
+  const int lo = std::clamp(left, 0, info.width);
+  const int hi = std::clamp<int64_t>(int64_t(left) + width, lo, info.width);
+  const std::size_t out_words = words_for(hi - lo);
+  const uint64_t tail = ((hi - lo) % 64 == 0)
+    ? ~uint64_t{0} : (uint64_t{1} << ((hi - lo) % 64)) - 1;
+
+  scan([&](const uint64_t, const uint64_t *words) {
+    packed_generation p{hi - lo, std::vector<uint64_t>(out_words, 0)};
+
+    // word j of the window is the 64 bits from cell lo + 64j on, which
+    // straddle two words of the row unless lo is word aligned
+    for (std::size_t j = 0; j < out_words; ++j) {
+      const std::size_t bit = lo + 64 * j;
+      const std::size_t w = bit / 64;
+      const int shift = bit % 64;
+
+      uint64_t v = words[w] >> shift;
+      if (shift != 0 && w + 1 < row_words) {
+        v |= words[w + 1] << (64 - shift);
+      }
+      p.words[j] = v;
+    }
+    if (out_words > 0) {
+      p.words.back() &= tail;
+    }
+
+    rows.push_back(std::move(p));
+  }, first, count);
+
+  return rows;
+}
+
+bool qca::archive_reader::read_chunk(const std::size_t c) {
+  if (c == chunk_index) { return true; }
+  if (c >= offsets.size()) { return false; }
+
+  const uint64_t rows = std::min<uint64_t>(
+    rows_per_chunk, info.rows - uint64_t(c) * rows_per_chunk
+  );
+
+  file.clear();
+  file.seekg(offsets[c]);
+  file.read(
+    reinterpret_cast<char *>(chunk.data()),
+    rows * row_words * sizeof(uint64_t)
+  );
+  if (!file) { return false; }
+
+  chunk_index = c;
+  return true;
+}
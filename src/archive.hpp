@@ -0,0 +1,122 @@
+#ifndef __ARCHIVE_HPP__
+#define __ARCHIVE_HPP__
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+namespace qca {
+  // everything needed to run an archived elementary run again
+  struct archive_info {
+    int width = 0;
+    uint8_t code = 0;
+    boundary edges = boundary::zero;
+    init_mode init = init_mode::single_1;
+    uint64_t seed = 0;
+    // generations stored, filled in by the writer
+    uint64_t rows = 0;
+  };
+
+  // an archive is a 64 byte header, then the bit-packed rows in chunks of
+  // `rows_per_chunk`, then an index of each chunk's file offset:
+  //   0   "QCAARCH\0"
+  //   8   u32 version
+  //   12  u32 width
+  //   16  u8 code, u8 boundary, u8 init mode, u8 zero
+  //   20  u32 rows per chunk
+  //   24  u64 seed
+  //   32  u64 rows
+  //   40  u64 index offset, 0 until the writer finishes
+  // all little endian. an archive that was never finished is still read,
+  // its chunks are found from the file size instead of the index.
+  class archive_writer {
+  public:
+    archive_writer(
+      const std::string &path, const archive_info &info,
+      const uint32_t rows_per_chunk=4096
+    );
+    ~archive_writer();
+
+    archive_writer(const archive_writer &) = delete;
+    archive_writer &operator=(const archive_writer &) = delete;
+
+    bool good() const;
+    void push(const packed_generation &g);
+    uint64_t size() const;
+
+    // writes the last chunk, the index and the final header. called by the
+    // destructor if not called before.
+    bool finish();
+  private:
+    void write_chunk();
+    void write_header(const uint64_t index_offset);
+
+    std::ofstream file;
+    archive_info info;
+    const uint32_t rows_per_chunk;
+    const std::size_t row_words;
+    bool finished = false;
+
+    std::vector<uint64_t> chunk;
+    uint32_t chunk_rows = 0;
+    std::vector<uint64_t> offsets;
+  };
+
+  class archive_reader {
+  public:
+    explicit archive_reader(const std::string &path);
+
+    bool good() const;
+    const archive_info &get_info() const;
+    uint64_t size() const;
+
+    // generation n, which must be below size()
+    packed_generation at(const uint64_t n);
+    // cells [left, left + width) of generations [first, first + count),
+    // clipped to the archive. reads only the chunks the window touches.
+    std::vector<packed_generation> window(
+      const uint64_t first, const uint64_t count, const int left,
+      const int width
+    );
+
+    // calls f(n, words) for generations [first, first + count) in order,
+    // reading a whole chunk at a time so a scan runs at the speed of the
+    // disk. words is only valid during the call.
+    template <typename F>
+    void scan(
+      const F &f, const uint64_t first=0, uint64_t count=~uint64_t{0}
+    ) {
+      count = std::min(count, size() - std::min(first, size()));
+      for (uint64_t n = first; n < first + count; ) {
+        const std::size_t c = n / rows_per_chunk;
+        if (!read_chunk(c)) { return; }
+
+        const uint64_t chunk_end = uint64_t(c + 1) * rows_per_chunk;
+        const uint64_t end = std::min(first + count, chunk_end);
+        for (; n < end; ++n) {
+          f(n, chunk.data() + (n - c * rows_per_chunk) * row_words);
+        }
+      }
+    }
+  private:
+    bool read_chunk(const std::size_t c);
+
+    std::ifstream file;
+    archive_info info;
+    bool ok = false;
+    uint32_t rows_per_chunk = 1;
+    std::size_t row_words = 0;
+    std::vector<uint64_t> offsets;
+
+    // the chunk last read
+    std::vector<uint64_t> chunk;
+    std::size_t chunk_index = ~std::size_t{0};
+  };
+}
+
+#endif // __ARCHIVE_HPP__
@@ -0,0 +1,23 @@
+#include <optional>
+#include <string_view>
+
+#include "boundary.hpp"
+
+const char *qca::boundary_name(const boundary b) {
+  switch (b) {
+    case boundary::one: return "one";
+    case boundary::periodic: return "periodic";
+    case boundary::reflect: return "reflect";
+    default: return "zero";
+  }
+}
+
+std::optional<qca::boundary> qca::parse_boundary(const std::string_view name) {
+  for (const boundary b : {
+    boundary::zero, boundary::one, boundary::periodic, boundary::reflect
+  }) {
+    if (name == boundary_name(b)) { return b; }
+  }
+
+  return std::nullopt;
+}
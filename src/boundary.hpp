@@ -0,0 +1,77 @@
+#ifndef __BOUNDARY_HPP__
+#define __BOUNDARY_HPP__
+#include <cstdint>
+#include <optional>
+#include <string_view>
+
+namespace qca {
+  enum class boundary { zero, one, periodic, reflect };
+
+  const char *boundary_name(const boundary b);
+  std::optional<boundary> parse_boundary(const std::string_view name);
+
+  // each policy gives the cells just outside a packed row of `width` cells,
+  // as seen by cell 0 (left) and cell width - 1 (right). they are written
+  // into the ghost cells once per generation so the step kernels never have
+  // to look at the edges.
+  namespace boundaries {
+    inline bool cell(const uint64_t *row, const int i) {
+      return (row[i / 64] >> (i % 64)) & 1;
+    }
+
+    struct zero {
+      static constexpr boundary type = boundary::zero;
+      static bool left(const uint64_t *, const int) { return false; }
+      static bool right(const uint64_t *, const int) { return false; }
+    };
+
+    struct one {
+      static constexpr boundary type = boundary::one;
+      static bool left(const uint64_t *, const int) { return true; }
+      static bool right(const uint64_t *, const int) { return true; }
+    };
+
+    struct periodic {
+      static constexpr boundary type = boundary::periodic;
+      static bool left(const uint64_t *row, const int width) {
+        return cell(row, width - 1);
+      }
+      static bool right(const uint64_t *row, const int) {
+        return cell(row, 0);
+      }
+    };
+
+    struct reflect {
+      static constexpr boundary type = boundary::reflect;
+      static bool left(const uint64_t *row, const int) {
+        return cell(row, 0);
+      }
+      static bool right(const uint64_t *row, const int width) {
+        return cell(row, width - 1);
+      }
+    };
+
+    // sets the ghost cells of a row with a ghost word either side of its
+    // cells, row points at the first word of cells.
+    // the right ghost cell is the bit just past the last cell, which is in
+    // the last word of cells unless the width is a multiple of 64.
+    template <typename Boundary>
+    void fill(uint64_t *row, const int width) {
+      const bool l = Boundary::left(row, width);
+      const bool r = Boundary::right(row, width);
+
+      row[-1] = uint64_t{l} << 63;
+
+      const uint64_t bit = uint64_t{1} << (width % 64);
+      if (width % 64 == 0) {
+        row[width / 64] = r ? bit : 0;
+      } else if (r) {
+        row[width / 64] |= bit;
+      } else {
+        row[width / 64] &= ~bit;
+      }
+    }
+  }
+}
+
+#endif // __BOUNDARY_HPP__
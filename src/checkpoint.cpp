@@ -0,0 +1,240 @@
+#include <cstdint>
+#include <cstring>
+#include <filesystem>
+#include <fstream>
+#include <mutex>
+#include <optional>
+#include <random>
+#include <sstream>
+#include <string>
+#include <system_error>
+#include <type_traits>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "checkpoint.hpp"
+#include "elementary.hpp"
+#include "util/trace.hpp"
+
+static constexpr char magic[8] = {'Q', 'C', 'A', 'C', 'K', 'P', 'T', '\0'};
+static constexpr uint32_t version = 2;
+
+template <typename T>
+static void put(std::ostream &out, const T &v) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  out.write(reinterpret_cast<const char *>(&v), sizeof(v));
+}
+
+template <typename T>
+static T get(std::istream &in) {
+  static_assert(std::is_trivially_copyable_v<T>);
+  T v{};
+  in.read(reinterpret_cast<char *>(&v), sizeof(v));
+  return v;
+}
+
+static void put_words(std::ostream &out, const std::vector<uint64_t> &words) {
+  put<uint64_t>(out, words.size());
+  out.write(
+    reinterpret_cast<const char *>(words.data()),
+    words.size() * sizeof(uint64_t)
+  );
+}
+
+// a count past what is left of the file is a bad file, not an allocation
+static bool get_words(
+  std::istream &in, std::vector<uint64_t> &words, const uint64_t limit
+) {
+  const uint64_t n = get<uint64_t>(in);
+  if (!in || n > limit) { return false; }
+
+  words.resize(n);
+  in.read(reinterpret_cast<char *>(words.data()), n * sizeof(uint64_t));
+  return bool(in);
+}
+
+// the engine only promises a textual state, which for mt19937 is a list of
+// numbers. they are stored as words rather than text.
+static std::vector<uint64_t> engine_words(const std::mt19937 &engine) {
+  std::stringstream ss;
+  ss << engine;
+
+  std::vector<uint64_t> words;
+  for (uint64_t w; ss >> w; ) {
+    words.push_back(w);
+  }
+
+  return words;
+}
+
+static bool set_engine(
+  std::mt19937 &engine, const std::vector<uint64_t> &words
+) {
+  std::stringstream ss;
+  for (const uint64_t w : words) {
+    ss << w << ' ';
+  }
+
+  ss >> engine;
+  return !ss.fail();
+}
+
+bool qca::write_checkpoint(
+  const std::string &path, const elementary_state &s
+) {
+  std::ofstream out(path, std::ios::binary);
+
+  out.write(magic, sizeof(magic));
+  put<uint32_t>(out, version);
+  put<uint32_t>(out, s.width);
+  put<uint32_t>(out, s.height);
+  put<uint32_t>(out, s.seed);
+  put<uint8_t>(out, static_cast<uint8_t>(s.init));
+  put<uint8_t>(out, rule_code(s.rules));
+  put<uint8_t>(out, rule_code(s.working_rules));
+  put<uint8_t>(out, static_cast<uint8_t>(s.edges));
+  put<uint8_t>(out, static_cast<uint8_t>(s.working_edges));
+  put<uint64_t>(out, s.generation);
+  put_words(out, s.row);
+
+  put<uint8_t>(out, s.cycle_detection);
+  put<uint8_t>(out, s.working_cycle_detection);
+  put<uint8_t>(out, s.found.has_value());
+  put_words(out, s.start);
+  put_words(out, s.tortoise);
+  put<uint64_t>(out, s.tortoise_hash);
+  put<uint64_t>(out, s.power);
+  put<uint64_t>(out, s.lap);
+  put<uint64_t>(out, s.furthest);
+  put<uint64_t>(out, s.found ? s.found->transient : 0);
+  put<uint64_t>(out, s.found ? s.found->period : 0);
+
+  put_words(out, engine_words(s.engine));
+
+  out.close();
+  return !out.fail();
+}
+
+std::optional<qca::elementary_state> qca::read_checkpoint(
+  const std::string &path
+) {
+  std::ifstream in(path, std::ios::binary);
+
+  char m[sizeof(magic)];
+  in.read(m, sizeof(m));
+  if (!in || std::memcmp(m, magic, sizeof(magic)) != 0) { return {}; }
+  if (get<uint32_t>(in) != version) { return {}; }
+
+  elementary_state s;
+  s.width = get<uint32_t>(in);
+  s.height = get<uint32_t>(in);
+  s.seed = get<uint32_t>(in);
+  const uint8_t init = get<uint8_t>(in);
+  if (init > static_cast<uint8_t>(init_mode::random)) { return {}; }
+  s.init = static_cast<init_mode>(init);
+  s.rules = wolfram(get<uint8_t>(in));
+  s.working_rules = wolfram(get<uint8_t>(in));
+
+  const uint8_t edges = get<uint8_t>(in);
+  const uint8_t working_edges = get<uint8_t>(in);
+  if (edges > 3 || working_edges > 3) { return {}; }
+  s.edges = static_cast<boundary>(edges);
+  s.working_edges = static_cast<boundary>(working_edges);
+
+  const uint64_t words = (uint64_t(s.width) + 63) / 64;
+  s.generation = get<uint64_t>(in);
+  if (!get_words(in, s.row, words)) { return {}; }
+
+  s.cycle_detection = get<uint8_t>(in);
+  s.working_cycle_detection = get<uint8_t>(in);
+  const bool found = get<uint8_t>(in);
+  if (!get_words(in, s.start, words)) { return {}; }
+  if (!get_words(in, s.tortoise, words)) { return {}; }
+  s.tortoise_hash = get<uint64_t>(in);
+  s.power = get<uint64_t>(in);
+  s.lap = get<uint64_t>(in);
+  s.furthest = get<uint64_t>(in);
+  const uint64_t transient = get<uint64_t>(in);
+  const uint64_t period = get<uint64_t>(in);
+  if (found) {
+    s.found = cycle{transient, period};
+  }
+
+  std::vector<uint64_t> engine;
+  if (!get_words(in, engine, 1024)) { return {}; }
+  if (!set_engine(s.engine, engine)) { return {}; }
+
+  return s;
+}
+
+qca::checkpoint_writer::checkpoint_writer(
+  const std::string &path, const uint64_t interval
+) : path(path), interval(interval), worker([this]() { work(); }) {}
+
+qca::checkpoint_writer::~checkpoint_writer() {
+  flush();
+  {
+    std::lock_guard<std::mutex> l(mutex);
+    stop = true;
+  }
+  wake.notify_one();
+  worker.join();
+}
+
+void qca::checkpoint_writer::tick(const elementary &ca) {
+  const uint64_t g = ca.generation_count();
+  if (interval == 0 || g == 0 || g % interval != 0) { return; }
+
+  submit(ca.get_state());
+}
+
+void qca::checkpoint_writer::submit(elementary_state s) {
+  {
+    std::lock_guard<std::mutex> l(mutex);
+    pending = std::move(s);
+  }
+  wake.notify_one();
+}
+
+bool qca::checkpoint_writer::flush() {
+  std::unique_lock<std::mutex> l(mutex);
+  idle.wait(l, [this]() { return !pending && !busy; });
+  return ok;
+}
+
+uint64_t qca::checkpoint_writer::written() const {
+  std::lock_guard<std::mutex> l(mutex);
+  return count;
+}
+
+void qca::checkpoint_writer::work() {
+  tracing::name_thread("checkpoint");
+  const std::string temporary = path + ".tmp";
+  std::unique_lock<std::mutex> l(mutex);
+
+  while (true) {
+    wake.wait(l, [this]() { return pending || stop; });
+    if (!pending) { return; }
+
+    elementary_state s = std::move(*pending);
+    pending.reset();
+    busy = true;
+    l.unlock();
+
+    tracing::begin("checkpoint");
+    std::error_code error;
+    bool written = write_checkpoint(temporary, s);
+    if (written) {
+      std::filesystem::rename(temporary, path, error);
+      written = !error;
+    }
+    tracing::end("checkpoint");
+
+    l.lock();
+    busy = false;
+    ok = ok && written;
+    count += written;
+    idle.notify_all();
+  }
+}
@@ -0,0 +1,62 @@
+#ifndef __CHECKPOINT_HPP__
+#define __CHECKPOINT_HPP__
+#include <condition_variable>
+#include <cstdint>
+#include <mutex>
+#include <optional>
+#include <string>
+#include <thread>
+
+#include "elementary.hpp"
+
+namespace qca {
+  // a checkpoint is the state of an elementary run in a small binary file:
+  // "QCACKPT\0", a u32 version, then the fields of elementary_state in
+  // order, rules as wolfram codes and each row as a u64 word count and its
+  // words. the random engine is kept as the numbers of its textual state.
+  // all little endian.
+  bool write_checkpoint(const std::string &path, const elementary_state &s);
+  std::optional<elementary_state> read_checkpoint(const std::string &path);
+
+  // writes checkpoints on a thread of its own, so the step loop only pays
+  // for copying the state. a checkpoint goes to a temporary file that is
+  // renamed over the last one, a crash mid write leaves the old one whole.
+  // if the writer falls behind, only the newest waiting checkpoint is kept.
+  class checkpoint_writer {
+  public:
+    // every `interval` generations, 0 only writes what is submitted
+    checkpoint_writer(const std::string &path, const uint64_t interval);
+    ~checkpoint_writer();
+
+    checkpoint_writer(const checkpoint_writer &) = delete;
+    checkpoint_writer &operator=(const checkpoint_writer &) = delete;
+
+    // submits ca's state if its generation is a multiple of the interval
+    void tick(const elementary &ca);
+    void submit(elementary_state s);
+
+    // waits for everything submitted to be written, false if any write
+    // has failed
+    bool flush();
+    // checkpoints written so far
+    uint64_t written() const;
+
+    const std::string path;
+    const uint64_t interval;
+  private:
+    void work();
+
+    mutable std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable idle;
+    std::optional<elementary_state> pending;
+    bool busy = false;
+    bool stop = false;
+    bool ok = true;
+    uint64_t count = 0;
+
+    std::thread worker;
+  };
+}
+
+#endif // __CHECKPOINT_HPP__
@@ -1,148 +1,837 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
 #include <cstdint>
-#include <map>
+#include <memory>
+#include <optional>
 #include <random>
+#include <string_view>
+#include <utility>
 #include <vector>
 
+#include "boundary.hpp"
 #include "elementary.hpp"
+#include "kernels.hpp"
+#include "light_cone.hpp"
+#include "linear.hpp"
+#include "util/trace.hpp"
 
-static const std::map<int, qca::cell> cells = {
-  {0, {0, 255, 255, 255}},
-  {1, {1, 0, 0, 0}},
-};
+#if defined(__x86_64__) || defined(__i386__)
+#define QCA_X86
+#include <immintrin.h>
+#endif
+
+// fewest words worth handing to a thread of their own
+static constexpr std::size_t min_chunk_words = 256;
+
+static constexpr std::size_t words_for(const int width) {
+  return (width + 63) / 64;
+}
+
+static constexpr uint64_t tail_mask(const int width) {
+  return (width % 64 == 0) ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1;
+}
+
+// multiply and fold over the words of a row, cheap next to the step itself
+static uint64_t hash_row(const std::vector<uint64_t> &row) {
+  uint64_t h = 0x9e3779b97f4a7c15;
+  for (std::size_t i = 1; i + 1 < row.size(); ++i) {
+    h = (h ^ row[i]) * 0xff51afd7ed558ccd;
+    h ^= h >> 32;
+  }
+
+  return h;
+}
+
+// compares the cells only, the ghost words hold whatever the last fill left
+static bool same_row(
+  const std::vector<uint64_t> &a, const std::vector<uint64_t> &b
+) {
+  return a.size() == b.size() &&
+    std::equal(a.begin() + 1, a.end() - 1, b.begin() + 1);
+}
+
+static void set_bit(qca::packed_generation &p, const int i, const bool v) {
+  const uint64_t bit = uint64_t{1} << (i % 64);
+  if (v) {
+    p.words[i / 64] |= bit;
+  } else {
+    p.words[i / 64] &= ~bit;
+  }
+}
+
+const char *qca::init_mode_name(const init_mode m) {
+  switch (m) {
+    case init_mode::single_0: return "single_0";
+    case init_mode::single_1: return "single_1";
+    case init_mode::alternate: return "alternate";
+    default: return "random";
+  }
+}
+
+std::optional<qca::init_mode> qca::parse_init_mode(
+  const std::string_view name
+) {
+  for (const init_mode m : {
+    init_mode::single_0, init_mode::single_1, init_mode::alternate,
+    init_mode::random
+  }) {
+    if (name == init_mode_name(m)) { return m; }
+  }
+
+  return std::nullopt;
+}
 
 qca::rule_set qca::wolfram(const uint8_t code) {
   rule_set r;
 
-  r[0x010101] = cells.at((code & 0b10000000) >> 7);
-  r[0x010100] = cells.at((code & 0b01000000) >> 6);
-  r[0x010001] = cells.at((code & 0b00100000) >> 5);
-  r[0x010000] = cells.at((code & 0b00010000) >> 4);
-  r[0x000101] = cells.at((code & 0b00001000) >> 3);
-  r[0x000100] = cells.at((code & 0b00000100) >> 2);
-  r[0x000001] = cells.at((code & 0b00000010) >> 1);
-  r[0x000000] = cells.at((code & 0b00000001));
+  for (int n = 0; n < 8; ++n) {
+    r[n] = (code >> n) & 1;
+  }
 
   return r;
 }
 
-std::vector<uint8_t> qca::cells_to_colour(const qca::generation &g) {
-  std::vector<uint8_t> colours;
+uint8_t qca::rule_code(const qca::rule_set &r) {
+  uint8_t code = 0;
 
-  for (const auto &c : g) {
-    colours.push_back(c.r);
-    colours.push_back(c.g);
-    colours.push_back(c.b);
+  for (int n = 0; n < 8; ++n) {
+    code |= (r[n] & 1) << n;
   }
 
-  return colours;
+  return code;
 }
 
-std::vector<uint8_t> qca::cells_to_colour(
-  const qca::history &h, const int width, const int height
+qca::packed_generation qca::pack(const qca::generation &g) {
+  packed_generation p{static_cast<int>(g.size()), {}};
+  p.words.resize(words_for(p.width));
+
+  for (int i = 0; i < p.width; ++i) {
+    set_bit(p, i, g[i] & 1);
+  }
+
+  return p;
+}
+
+uint8_t qca::transform(const uint8_t code, const symmetry s) {
+  const rule_set r = wolfram(code);
+  rule_set out;
+
+  for (int n = 0; n < 8; ++n) {
+    int from = s.mirror ? ((n & 1) << 2 | (n & 2) | (n >> 2)) : n;
+    if (s.complement) { from = 7 - from; }
+    out[n] = r[from] ^ s.complement;
+  }
+
+  return rule_code(out);
+}
+
+qca::boundary qca::transform(const boundary b, const symmetry s) {
+  if (!s.complement) { return b; }
+
+  switch (b) {
+    case boundary::zero: return boundary::one;
+    case boundary::one: return boundary::zero;
+    default: return b;
+  }
+}
+
+static uint64_t reverse_bits(uint64_t v) {
+  v = (v >> 1 & 0x5555555555555555) | (v & 0x5555555555555555) << 1;
+  v = (v >> 2 & 0x3333333333333333) | (v & 0x3333333333333333) << 2;
+  v = (v >> 4 & 0x0f0f0f0f0f0f0f0f) | (v & 0x0f0f0f0f0f0f0f0f) << 4;
+  return __builtin_bswap64(v);
+}
+
+// mirroring reverses the words and the bits of each, which leaves the cells
+// at the top of the words, then shifts them back down
+qca::packed_generation qca::transform(
+  const packed_generation &p, const symmetry s
 ) {
-  std::vector<uint8_t> colours;
+  packed_generation out{p.width, p.words};
+  const std::size_t n = out.words.size();
+  if (n == 0) { return out; }
 
-  int counter = 0;
-  for (const auto &g : h) {
-    counter++;
-    for (const auto &c : g) {
-      colours.push_back(c.r);
-      colours.push_back(c.g);
-      colours.push_back(c.b);
+  if (s.mirror) {
+    for (std::size_t i = 0; i < n; ++i) {
+      out.words[i] = reverse_bits(p.words[n - 1 - i]);
+    }
+
+    const int pad = n * 64 - p.width;
+    if (pad != 0) {
+      for (std::size_t i = 0; i < n; ++i) {
+        const uint64_t next = (i + 1 < n) ? out.words[i + 1] : 0;
+        out.words[i] = out.words[i] >> pad | next << (64 - pad);
+      }
     }
   }
 
-  while (counter < height) {
-    counter++;
-    for (int i = 0; i < width; ++i) {
-      colours.push_back(0);
-      colours.push_back(0);
-      colours.push_back(0);
+  if (s.complement) {
+    for (uint64_t &w : out.words) { w = ~w; }
+    out.words.back() &= tail_mask(p.width);
+  }
+
+  return out;
+}
+
+uint8_t qca::canonical_code(const uint8_t code) {
+  uint8_t least = code;
+  for (const bool m : {false, true}) {
+    for (const bool c : {false, true}) {
+      least = std::min(least, transform(code, symmetry{m, c}));
     }
   }
 
+  return least;
+}
+
+qca::equivalent qca::canonical(
+  const uint8_t code, const packed_generation &row, const boundary b
+) {
+  equivalent best{code, {}};
+
+  for (const bool m : {false, true}) {
+    for (const bool c : {false, true}) {
+      const symmetry s{m, c};
+      if (!m && !c) { continue; }
+      if (transform(b, s) != b) { continue; }
+      if (transform(row, s).words != row.words) { continue; }
+
+      const uint8_t other = transform(code, s);
+      if (other < best.code) {
+        best = {other, s};
+      }
+    }
+  }
+
+  return best;
+}
+
+qca::generation qca::unpack(const qca::packed_generation &p) {
+  generation g;
+  g.reserve(p.width);
+
+  for (int i = 0; i < p.width; ++i) {
+    g.push_back((p.words[i / 64] >> (i % 64)) & 1);
+  }
+
+  return g;
+}
+
+qca::palette qca::greyscale(const int states) {
+  palette p;
+
+  for (int s = 0; s < states; ++s) {
+    const uint8_t grey = 255 - (255 * s) / std::max(states - 1, 1);
+    p.push_back({grey, grey, grey});
+  }
+
+  return p;
+}
+
+static void expand_scalar(
+  const uint8_t *states, const std::size_t n, const qca::palette &p,
+  uint8_t *out
+) {
+  for (std::size_t i = 0; i < n; ++i) {
+    const qca::colour c = p[states[i]];
+    out[3 * i] = c.r;
+    out[3 * i + 1] = c.g;
+    out[3 * i + 2] = c.b;
+  }
+}
+
+static void expand_packed_scalar(
+  const uint64_t *words, const std::size_t begin, const std::size_t end,
+  const qca::palette &p, uint8_t *out
+) {
+  for (std::size_t i = begin; i < end; ++i) {
+    const qca::colour c = p[(words[i / 64] >> (i % 64)) & 1];
+    out[3 * i] = c.r;
+    out[3 * i + 1] = c.g;
+    out[3 * i + 2] = c.b;
+  }
+}
+
+#ifdef QCA_X86
+// byte j of output register k is channel (16k + j) % 3 of cell (16k + j) / 3,
+// so channel c's register shuffled by interleave[k][c] puts its bytes there
+// and zeroes the rest
+struct interleave_masks {
+  int8_t m[3][3][16];
+};
+
+static constexpr interleave_masks make_interleave() {
+  interleave_masks masks{};
+  for (int k = 0; k < 3; ++k) {
+    for (int c = 0; c < 3; ++c) {
+      for (int j = 0; j < 16; ++j) {
+        const int at = 16 * k + j;
+        masks.m[k][c][j] = (at % 3 == c) ? at / 3 : -1;
+      }
+    }
+  }
+
+  return masks;
+}
+
+static constexpr interleave_masks interleave = make_interleave();
+
+// the palette as three 16 entry tables, one per channel
+struct palette_tables {
+  __m128i r;
+  __m128i g;
+  __m128i b;
+};
+
+__attribute__((target("ssse3")))
+static palette_tables make_tables(const qca::palette &p) {
+  alignas(16) uint8_t r[16] = {};
+  alignas(16) uint8_t g[16] = {};
+  alignas(16) uint8_t b[16] = {};
+  for (std::size_t s = 0; s < p.size() && s < 16; ++s) {
+    r[s] = p[s].r;
+    g[s] = p[s].g;
+    b[s] = p[s].b;
+  }
+
+  return {
+    _mm_load_si128((const __m128i *)r),
+    _mm_load_si128((const __m128i *)g),
+    _mm_load_si128((const __m128i *)b),
+  };
+}
+
+// 16 states in, 48 rgb bytes out: a lookup per channel, then three shuffles
+// per output register to interleave them
+__attribute__((target("ssse3")))
+static inline void expand16(
+  const __m128i states, const palette_tables &t, uint8_t *out
+) {
+  const __m128i r = _mm_shuffle_epi8(t.r, states);
+  const __m128i g = _mm_shuffle_epi8(t.g, states);
+  const __m128i b = _mm_shuffle_epi8(t.b, states);
+
+  for (int k = 0; k < 3; ++k) {
+    const __m128i *m = (const __m128i *)interleave.m[k];
+    const __m128i rgb = _mm_or_si128(
+      _mm_or_si128(
+        _mm_shuffle_epi8(r, _mm_loadu_si128(m)),
+        _mm_shuffle_epi8(g, _mm_loadu_si128(m + 1))
+      ),
+      _mm_shuffle_epi8(b, _mm_loadu_si128(m + 2))
+    );
+    _mm_storeu_si128((__m128i *)(out + 16 * k), rgb);
+  }
+}
+
+__attribute__((target("ssse3")))
+static void expand_ssse3(
+  const uint8_t *states, const std::size_t n, const qca::palette &p,
+  uint8_t *out
+) {
+  const palette_tables t = make_tables(p);
+
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    expand16(_mm_loadu_si128((const __m128i *)(states + i)), t, out + 3 * i);
+  }
+
+  expand_scalar(states + i, n - i, p, out + 3 * i);
+}
+
+// 16 bits never straddle a word, as i steps in 16s. each bit is spread to a
+// byte by copying its byte of the row to 8 lanes and testing one bit in each.
+__attribute__((target("ssse3")))
+static void expand_packed_ssse3(
+  const uint64_t *words, const std::size_t n, const qca::palette &p,
+  uint8_t *out
+) {
+  const palette_tables t = make_tables(p);
+  const __m128i spread = _mm_setr_epi8(
+    0, 0, 0, 0, 0, 0, 0, 0, 1, 1, 1, 1, 1, 1, 1, 1
+  );
+  const __m128i bits = _mm_setr_epi8(
+    1, 2, 4, 8, 16, 32, 64, -128, 1, 2, 4, 8, 16, 32, 64, -128
+  );
+  const __m128i one = _mm_set1_epi8(1);
+
+  std::size_t i = 0;
+  for (; i + 16 <= n; i += 16) {
+    const int16_t row = static_cast<int16_t>(words[i / 64] >> (i % 64));
+    const __m128i bytes = _mm_shuffle_epi8(_mm_set1_epi16(row), spread);
+    const __m128i set = _mm_cmpeq_epi8(_mm_and_si128(bytes, bits), bits);
+    expand16(_mm_and_si128(set, one), t, out + 3 * i);
+  }
+
+  expand_packed_scalar(words, i, n, p, out);
+}
+
+static bool use_ssse3(const qca::palette &p) {
+  static const bool supported = qca::active_isa() >= qca::isa::sse2 &&
+    __builtin_cpu_supports("ssse3");
+  return supported && p.size() <= 16;
+}
+#endif // QCA_X86
+
+void qca::cells_to_colour(
+  const qca::generation &g, const qca::palette &p, uint8_t *out
+) {
+#ifdef QCA_X86
+  if (use_ssse3(p)) {
+    expand_ssse3(g.data(), g.size(), p, out);
+    return;
+  }
+#endif
+  expand_scalar(g.data(), g.size(), p, out);
+}
+
+void qca::cells_to_colour(
+  const qca::packed_generation &g, const qca::palette &p, uint8_t *out
+) {
+#ifdef QCA_X86
+  if (use_ssse3(p)) {
+    expand_packed_ssse3(g.words.data(), g.width, p, out);
+    return;
+  }
+#endif
+  expand_packed_scalar(g.words.data(), 0, g.width, p, out);
+}
+
+std::vector<uint8_t> qca::cells_to_colour(
+  const qca::generation &g, const qca::palette &p
+) {
+  std::vector<uint8_t> colours(3 * g.size());
+  cells_to_colour(g, p, colours.data());
+
   return colours;
 }
 
-qca::elementary::elementary(const int w, const int h, const rule_set &r)
-: field_width(w), field_height(h), rules(r) {
-  engine.seed(std::random_device{}());
+std::vector<uint8_t> qca::cells_to_colour(
+  const qca::history &h, const qca::palette &p, const int width,
+  const int height
+) {
+  const std::size_t rows = std::max<std::size_t>(h.size(), height);
+  std::vector<uint8_t> colours(3 * rows * width);
+
+  // rows past the end of the history are left black
+  uint8_t *out = colours.data();
+  for (const auto &g : h) {
+    cells_to_colour(g, p, out);
+    out += 3 * g.size();
+  }
+
+  return colours;
+}
+
+qca::elementary::elementary(
+  const int w, const int h, const rule_set &r, const boundary b
+) : field_width(w), field_height(h), rules(r), edges(b) {
+  seed(std::random_device{}());
   init_single_1();
 }
 
 void qca::elementary::init_single_0() {
   reset();
-  for (int i = 0; i < field_width; ++i) {
-    current_generation.push_back(cells.at(1));
-  }
+  run_init = init_mode::single_0;
+  front.assign(words_for(field_width) + 2, ~uint64_t{0});
+  back.assign(front.size(), 0);
 
-  current_generation[field_width / 2] = cells.at(0);
+  front.front() = 0;
+  front.back() = 0;
+  front[front.size() - 2] &= tail_mask(field_width);
+  set_cell(field_width / 2, false);
 }
 
 void qca::elementary::init_single_1() {
   reset();
-  for (int i = 0; i < field_width; ++i) {
-    current_generation.push_back(cells.at(0));
-  }
+  run_init = init_mode::single_1;
+  front.assign(words_for(field_width) + 2, 0);
+  back.assign(front.size(), 0);
 
-  current_generation[field_width / 2] = cells.at(1);
+  set_cell(field_width / 2, true);
 }
 
 void qca::elementary::init_alternate() {
   reset();
+  run_init = init_mode::alternate;
+  front.assign(words_for(field_width) + 2, 0);
+  back.assign(front.size(), 0);
+
   for (int i = 0; i < field_width; ++i) {
-    current_generation.push_back(cells.at(i % 2));
+    set_cell(i, i % 2);
   }
 }
 
 void qca::elementary::init_random() {
   reset();
+  run_init = init_mode::random;
+  front.assign(words_for(field_width) + 2, 0);
+  back.assign(front.size(), 0);
   std::uniform_int_distribution d{0, 1};
 
   for (int i = 0; i < field_width; ++i) {
-    current_generation.push_back(cells.at(d(engine)));
+    set_cell(i, d(engine));
   }
 }
 
+void qca::elementary::init(const init_mode m) {
+  switch (m) {
+    case init_mode::single_0: init_single_0(); break;
+    case init_mode::single_1: init_single_1(); break;
+    case init_mode::alternate: init_alternate(); break;
+    case init_mode::random: init_random(); break;
+  }
+}
+
+void qca::elementary::seed(const uint32_t s) {
+  engine.seed(s);
+  run_seed = s;
+}
+
 void qca::elementary::set_rules(const rule_set &r) {
   rules = r;
 }
 
+void qca::elementary::set_palette(const palette &p) {
+  colours = p;
+}
+
+const qca::palette &qca::elementary::get_palette() const {
+  return colours;
+}
+
+void qca::elementary::set_boundary(const boundary b) {
+  edges = b;
+}
+
+qca::boundary qca::elementary::get_boundary() const {
+  return edges;
+}
+
+void qca::elementary::set_threads(const int n) {
+  if (n <= 1) {
+    pool.reset();
+  } else if (n != get_threads()) {
+    pool = std::make_shared<threading::Pool>(n);
+  }
+}
+
+int qca::elementary::get_threads() const {
+  return pool ? pool->size() : 1;
+}
+
+void qca::elementary::set_cycle_detection(const bool on) {
+  cycle_detection = on;
+}
+
+std::optional<qca::cycle> qca::elementary::get_cycle() const {
+  return found;
+}
+
 qca::generation qca::elementary::get() const {
-  return current_generation;
+  return unpack(get_packed());
+}
+
+qca::packed_generation qca::elementary::get_packed() const {
+  packed_generation p{field_width, {}};
+  if (!front.empty()) {
+    p.words.assign(front.begin() + 1, front.end() - 1);
+  }
+
+  return p;
+}
+
+uint8_t qca::elementary::cell_at(const int x, const uint64_t t) const {
+  return qca::cell_at(get_packed(), code, working_edges, x, t);
+}
+
+std::vector<uint8_t> qca::elementary::column(
+  const int x, const uint64_t n
+) const {
+  return qca::column(get_packed(), code, working_edges, x, n);
 }
 
 void qca::elementary::next() {
-  generation next_generation;
-  next_generation.resize(current_generation.size());
-
-  for (int i = 0; i < current_generation.size(); ++i) {
-    generation parents = {
-      cells.at(0),
-      current_generation[i],
-      cells.at(0)
-    };
-
-    if (i != 0) {
-      parents[0] = current_generation[i - 1];
+  if (front.empty()) { return; }
+
+  if (working_cycle_detection && start.empty()) {
+    start = front;
+    tortoise = front;
+    tortoise_hash = hash_row(front);
+  }
+
+  advance(front, back);
+  gen_count++;
+
+  if (working_cycle_detection && !found && gen_count > furthest) {
+    furthest = gen_count;
+    track_cycle();
+  }
+}
+
+uint64_t qca::elementary::generation_count() const {
+  return gen_count;
+}
+
+bool qca::elementary::advance_to(const uint64_t n) {
+  if (front.empty()) { return false; }
+
+  if (found && n >= found->transient && gen_count >= found->transient) {
+    const uint64_t period = found->period;
+    const uint64_t from = (gen_count - found->transient) % period;
+    const uint64_t to = (n - found->transient) % period;
+
+    for (uint64_t s = (to + period - from) % period; s > 0; --s) {
+      advance(front, back);
     }
+    gen_count = n;
+    return true;
+  }
+
+  if (n < gen_count) {
+    if (start.empty()) { return false; }
+    front = start;
+    gen_count = 0;
+  }
 
-    if (i != field_width - 1) {
-      parents[2] = current_generation[i + 1];
+  if (gen_count < n && try_jump(n - gen_count)) {
+    return true;
+  }
+
+  while (gen_count < n) {
+    if (found && gen_count >= found->transient) {
+      return advance_to(n);
     }
+    next();
+  }
+
+  return true;
+}
+
+void qca::elementary::fast_forward(const uint64_t n) {
+  if (front.empty() || n == 0) { return; }
 
-    uint64_t next_index = 0;
-    next_index |= parents[0].state << 16;
-    next_index |= parents[1].state << 8;
-    next_index |= parents[2].state;
+  advance_to(gen_count + n);
+}
 
-    next_generation[i] = working_rules.at(next_index);
+bool qca::elementary::is_linear() const {
+  return affine(code).has_value();
+}
+
+bool qca::elementary::try_jump(const uint64_t n) {
+  if (front.empty()) { return false; }
+
+  const std::optional<packed_generation> to =
+    jump(get_packed(), code, working_edges, n);
+  if (!to) { return false; }
+
+  if (working_cycle_detection && start.empty()) {
+    start = front;
   }
 
-  current_generation = next_generation;
+  std::copy(to->words.begin(), to->words.end(), front.begin() + 1);
+  gen_count += n;
+
+  // the search cannot follow a jump, so it starts over where it landed.
+  // brent's algorithm finds the same period from any generation of a run.
+  if (working_cycle_detection && !found && gen_count > furthest) {
+    furthest = gen_count;
+    tortoise = front;
+    tortoise_hash = hash_row(front);
+    power = 1;
+    lap = 0;
+  }
+
+  return true;
 }
 
 void qca::elementary::reset() {
-  current_generation.clear();
+  front.clear();
+  back.clear();
   working_rules = rules;
+  code = rule_code(working_rules);
+  working_edges = edges;
+
+  gen_count = 0;
+  working_cycle_detection = cycle_detection;
+  start.clear();
+  tortoise.clear();
+  power = 1;
+  lap = 0;
+  furthest = 0;
+  found.reset();
+}
+
+// the ghost words are dropped, and put back as zero on the way in
+static std::vector<uint64_t> cells_of(const std::vector<uint64_t> &row) {
+  if (row.empty()) { return {}; }
+  return {row.begin() + 1, row.end() - 1};
+}
+
+static std::vector<uint64_t> with_ghosts(const std::vector<uint64_t> &cells) {
+  if (cells.empty()) { return {}; }
+
+  std::vector<uint64_t> row(cells.size() + 2, 0);
+  std::copy(cells.begin(), cells.end(), row.begin() + 1);
+  return row;
+}
+
+qca::elementary_state qca::elementary::get_state() const {
+  elementary_state s;
+  s.width = field_width;
+  s.height = field_height;
+  s.seed = run_seed;
+  s.init = run_init;
+  s.rules = rules;
+  s.working_rules = working_rules;
+  s.edges = edges;
+  s.working_edges = working_edges;
+  s.generation = gen_count;
+  s.row = cells_of(front);
+
+  s.cycle_detection = cycle_detection;
+  s.working_cycle_detection = working_cycle_detection;
+  s.start = cells_of(start);
+  s.tortoise = cells_of(tortoise);
+  s.tortoise_hash = tortoise_hash;
+  s.power = power;
+  s.lap = lap;
+  s.furthest = furthest;
+  s.found = found;
+
+  s.engine = engine;
+  return s;
+}
+
+bool qca::elementary::set_state(const elementary_state &s) {
+  if (s.width <= 0 || s.height < 0) { return false; }
+
+  const std::size_t words = words_for(s.width);
+  for (const auto *cells : {&s.row, &s.start, &s.tortoise}) {
+    if (!cells->empty() && cells->size() != words) { return false; }
+    if (!cells->empty() && (cells->back() & ~tail_mask(s.width)) != 0) {
+      return false;
+    }
+  }
+
+  field_width = s.width;
+  field_height = s.height;
+  run_seed = s.seed;
+  run_init = s.init;
+  rules = s.rules;
+  working_rules = s.working_rules;
+  code = rule_code(working_rules);
+  edges = s.edges;
+  working_edges = s.working_edges;
+  gen_count = s.generation;
+  front = with_ghosts(s.row);
+  back.assign(front.size(), 0);
+
+  cycle_detection = s.cycle_detection;
+  working_cycle_detection = s.working_cycle_detection;
+  start = with_ghosts(s.start);
+  tortoise = with_ghosts(s.tortoise);
+  tortoise_hash = s.tortoise_hash;
+  power = s.power;
+  lap = s.lap;
+  furthest = s.furthest;
+  found = s.found;
+
+  engine = s.engine;
+  return true;
+}
+
+void qca::elementary::set_cell(const int i, const bool v) {
+  const uint64_t bit = uint64_t{1} << (i % 64);
+  if (v) {
+    front[1 + i / 64] |= bit;
+  } else {
+    front[1 + i / 64] &= ~bit;
+  }
+}
+
+void qca::elementary::advance(
+  std::vector<uint64_t> &row, std::vector<uint64_t> &scratch
+) {
+  // the boundary is picked once per generation, each policy gets its own
+  // copy of the step with the edge handling compiled in
+  switch (working_edges) {
+    case boundary::zero: step<boundaries::zero>(row, scratch); break;
+    case boundary::one: step<boundaries::one>(row, scratch); break;
+    case boundary::periodic: step<boundaries::periodic>(row, scratch); break;
+    case boundary::reflect: step<boundaries::reflect>(row, scratch); break;
+  }
+}
+
+void qca::elementary::track_cycle() {
+  lap++;
+
+  const uint64_t h = hash_row(front);
+  if (h == tortoise_hash && same_row(front, tortoise)) {
+    // the period is lap. the transient is where a row started a period ahead
+    // first meets the start, so run the two side by side from the beginning.
+    std::vector<uint64_t> a = start;
+    std::vector<uint64_t> b = start;
+    std::vector<uint64_t> scratch(start.size(), 0);
+
+    for (uint64_t s = 0; s < lap; ++s) {
+      advance(b, scratch);
+    }
+
+    uint64_t transient = 0;
+    while (!same_row(a, b)) {
+      advance(a, scratch);
+      advance(b, scratch);
+      transient++;
+    }
+
+    found = cycle{transient, lap};
+    tortoise.clear();
+    return;
+  }
+
+  if (lap == power) {
+    tortoise = front;
+    tortoise_hash = h;
+    power *= 2;
+    lap = 0;
+  }
+}
+
+template <typename Boundary>
+void qca::elementary::step(
+  std::vector<uint64_t> &row, std::vector<uint64_t> &scratch
+) {
+  const std::size_t n = row.size() - 2;
+  const step_kernel kernel = active_kernel();
+  const uint64_t *src = row.data() + 1;
+  uint64_t *dst = scratch.data() + 1;
+
+  boundaries::fill<Boundary>(row.data() + 1, field_width);
+
+  const std::size_t chunks = std::min<std::size_t>(
+    get_threads(), (n + min_chunk_words - 1) / min_chunk_words
+  );
+
+  if (chunks <= 1) {
+    kernel(src, dst, 0, n, code);
+  } else {
+    // every chunk reads its edge neighbours straight from src, so the chunks
+    // only need to meet once the whole generation is written
+    pool->run([&](const std::size_t index, const std::size_t) {
+      if (index >= chunks) { return; }
+
+      tracing::Span span("step chunk");
+      const std::size_t begin = n * index / chunks;
+      const std::size_t end = n * (index + 1) / chunks;
+      kernel(src, dst, begin, end, code);
+    });
+  }
+
+  // clear the bits past the last cell, the ghost cell among them is filled
+  // again before the next step
+  dst[n - 1] &= tail_mask(field_width);
+
+  std::swap(row, scratch);
 }
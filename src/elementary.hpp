@@ -1,52 +1,239 @@
 #ifndef __ELEMENTARY_HPP__
 #define __ELEMENTARY_HPP__
+#include <array>
 #include <cstdint>
-#include <map>
+#include <memory>
+#include <optional>
 #include <random>
+#include <string_view>
 #include <vector>
 
+#include "boundary.hpp"
+#include "util/thread_pool.hpp"
+
 namespace qca {
-  struct cell {
-    uint8_t state;
+  // cells are stored as bare state indices, colour is only looked up in a
+  // palette when a row is drawn
+  struct colour {
     uint8_t r;
     uint8_t g;
     uint8_t b;
   };
 
-  using generation = std::vector<cell>;
+  // indexed by state
+  using palette = std::vector<colour>;
+  using generation = std::vector<uint8_t>;
   using history = std::vector<generation>;
-  using rule_set = std::map<uint64_t, cell>;
+  // the next state, indexed by the neighbourhood (left << 2 | centre << 1 |
+  // right)
+  using rule_set = std::array<uint8_t, 8>;
+
+  // one bit per cell, 64 cells per word, cell i is bit (i % 64) of word i / 64
+  // bits past `width` in the last word are always zero
+  struct packed_generation {
+    int width = 0;
+    std::vector<uint64_t> words;
+  };
+
+  enum class init_mode { single_0, single_1, alternate, random };
+
+  const char *init_mode_name(const init_mode m);
+  std::optional<init_mode> parse_init_mode(const std::string_view name);
+
+  // a run that repeats: from generation `transient` on, every generation
+  // equals the one `period` generations after it. a fixed point has period 1.
+  struct cycle {
+    uint64_t transient = 0;
+    uint64_t period = 0;
+  };
+
+  // everything an elementary run needs to carry on exactly where it left
+  // off, rows are packed without their ghost words. see checkpoint.hpp for
+  // keeping it in a file.
+  struct elementary_state {
+    int width = 0;
+    int height = 0;
+    // the seed and init mode the run started from, to describe it by
+    uint32_t seed = 0;
+    init_mode init = init_mode::single_1;
+    // the pending rules and boundary, and the ones the current run uses
+    rule_set rules{};
+    rule_set working_rules{};
+    boundary edges = boundary::zero;
+    boundary working_edges = boundary::zero;
+    uint64_t generation = 0;
+    std::vector<uint64_t> row;
+
+    bool cycle_detection = false;
+    bool working_cycle_detection = false;
+    std::vector<uint64_t> start;
+    std::vector<uint64_t> tortoise;
+    uint64_t tortoise_hash = 0;
+    uint64_t power = 1;
+    uint64_t lap = 0;
+    uint64_t furthest = 0;
+    std::optional<cycle> found;
+
+    std::mt19937 engine;
+  };
 
   rule_set wolfram(const uint8_t code);
+  uint8_t rule_code(const rule_set &r);
+
+  // swapping left and right and swapping 0 and 1, either, both or neither.
+  // a run of a code, mirrored and/or complemented, is a run of the code
+  // transformed the same way from the transformed row and boundary, which
+  // folds the 256 codes into 88 classes.
+  struct symmetry {
+    bool mirror = false;
+    bool complement = false;
+  };
+
+  uint8_t transform(const uint8_t code, const symmetry s);
+  // complementing swaps the zero and one boundaries
+  boundary transform(const boundary b, const symmetry s);
+  packed_generation transform(const packed_generation &p, const symmetry s);
 
-  std::vector<uint8_t> cells_to_colour(const generation &g);
+  // the smallest code of the class of code
+  uint8_t canonical_code(const uint8_t code);
+
+  // a code whose run from a given row is another code's run, transformed
+  struct equivalent {
+    uint8_t code = 0;
+    symmetry from;
+  };
+
+  // the smallest code whose run from row under boundary b gives code's run
+  // from the same row, as `from` applied to each of its generations. only
+  // the symmetries that leave the row and boundary as they are count, so
+  // for most rows this is code itself.
+  equivalent canonical(
+    const uint8_t code, const packed_generation &row, const boundary b
+  );
+
+  packed_generation pack(const generation &g);
+  generation unpack(const packed_generation &p);
+
+  // state s of k drawn as grey level 255 * (1 - s/(k-1)), 0 white, k-1 black
+  palette greyscale(const int states);
+
+  // write the 3 * width rgb bytes of a row straight into out
+  void cells_to_colour(const generation &g, const palette &p, uint8_t *out);
+  void cells_to_colour(
+    const packed_generation &g, const palette &p, uint8_t *out
+  );
+
+  std::vector<uint8_t> cells_to_colour(const generation &g, const palette &p);
   std::vector<uint8_t> cells_to_colour(
-    const history &h, const int width, const int height
+    const history &h, const palette &p, const int width, const int height
   );
 
   class elementary {
   public:
     elementary() = default;
-    elementary(const int w, const int h, const rule_set &r);
+    elementary(
+      const int w, const int h, const rule_set &r,
+      const boundary b=boundary::zero
+    );
 
     void init_single_0();
     void init_single_1();
     void init_alternate();
     void init_random();
+    void init(const init_mode m);
+    // reseeds the engine init_random() draws from, so runs can be repeated
+    void seed(const uint32_t s);
     void set_rules(const rule_set &r);
+    // only used when drawing, so unlike the rules it applies straight away
+    void set_palette(const palette &p);
+    const palette &get_palette() const;
+    // like the rules, a new boundary takes effect on the next reset
+    void set_boundary(const boundary b);
+    boundary get_boundary() const;
+
+    // splits each step across n threads, 1 steps on the calling thread.
+    // narrow fields stay serial as they are not worth the synchronisation.
+    void set_threads(const int n);
+    int get_threads() const;
+
+    // hashes every generation and finds the first repeat with brent's
+    // algorithm, off by default. like the rules, takes effect on the next
+    // reset.
+    void set_cycle_detection(const bool on);
+    // set once the current run has been seen to repeat
+    std::optional<cycle> get_cycle() const;
 
     generation get() const;
+    packed_generation get_packed() const;
     void next();
+    // generations stepped since the last init
+    uint64_t generation_count() const;
+    // moves to generation n of the current run, going round a known cycle by
+    // the period rather than stepping it. going back needs the first
+    // generation, which only cycle detection keeps, false if it is missing.
+    bool advance_to(const uint64_t n);
+    // steps n generations. affine rules (see linear.hpp) jump there in
+    // O(width log n) where they can, the rest step as next() does.
+    void fast_forward(const uint64_t n);
+    bool is_linear() const;
+
+    // cell x, t generations on from the current one, and cell x of the next
+    // n generations starting with the current one. both evolve only the
+    // backward light cone of the cells asked for, see light_cone.hpp
+    uint8_t cell_at(const int x, const uint64_t t) const;
+    std::vector<uint8_t> column(const int x, const uint64_t n) const;
     void reset();
 
+    // a copy of the run, including the random engine, that set_state()
+    // continues identically. the palette and threads are left as they are.
+    // false, changing nothing, if the rows do not fit the width.
+    elementary_state get_state() const;
+    bool set_state(const elementary_state &s);
+
     int field_width;
     int field_height;
   private:
-    generation current_generation;
+    void set_cell(const int i, const bool v);
+    // steps row on a generation, using scratch as the other buffer
+    void advance(std::vector<uint64_t> &row, std::vector<uint64_t> &scratch);
+    template <typename Boundary>
+    void step(std::vector<uint64_t> &row, std::vector<uint64_t> &scratch);
+    void track_cycle();
+    // jumps n generations ahead, false if the rule has no quick way there
+    bool try_jump(const uint64_t n);
+
+    // the current row is front, next() writes the following one into back
+    // and swaps them. both keep a zero ghost word at each end, words
+    // [1, size - 1) hold the cells.
+    std::vector<uint64_t> front;
+    std::vector<uint64_t> back;
     rule_set rules;
     rule_set working_rules;
+    uint8_t code = 0;
+    palette colours = greyscale(2);
+    boundary edges = boundary::zero;
+    boundary working_edges = boundary::zero;
+    uint64_t gen_count = 0;
+
+    // brent's algorithm: the tortoise sits at the last power of two, `lap`
+    // generations behind the current one, and moves up to it when lap
+    // reaches `power`. matching hashes are confirmed against its words.
+    bool cycle_detection = false;
+    bool working_cycle_detection = false;
+    std::vector<uint64_t> start;
+    std::vector<uint64_t> tortoise;
+    uint64_t tortoise_hash = 0;
+    uint64_t power = 1;
+    uint64_t lap = 0;
+    // the furthest generation tracked, stepping again after going back to
+    // start does not feed the search twice
+    uint64_t furthest = 0;
+    std::optional<cycle> found;
 
     std::mt19937 engine;
+    uint32_t run_seed = 0;
+    init_mode run_init = init_mode::single_1;
+    std::shared_ptr<threading::Pool> pool;
   };
 }
 
@@ -0,0 +1,171 @@
+#include <algorithm>
+#include <cstdint>
+#include <random>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+#include "ensemble.hpp"
+#include "kernels.hpp"
+
+qca::ensemble::ensemble(
+  const int w, const rule_set &r, const int members, const boundary b
+) : field_width(w), lanes(std::max(1, (members + 63) / 64)),
+    code(rule_code(r)), edges(b) {
+  engine.seed(std::random_device{}());
+
+  front.assign(std::size_t(field_width + 2) * lanes, 0);
+  back.assign(front.size(), 0);
+  active.assign(lanes, ~uint64_t{0});
+  frozen.assign(std::size_t(lanes) * 64, -1);
+}
+
+void qca::ensemble::init_random() {
+  for (int i = 0; i < field_width; ++i) {
+    for (int j = 0; j < lanes; ++j) {
+      front[std::size_t(i + 1) * lanes + j] = engine();
+    }
+  }
+
+  std::fill(active.begin(), active.end(), ~uint64_t{0});
+  std::fill(frozen.begin(), frozen.end(), -1);
+  gen_count = 0;
+}
+
+void qca::ensemble::set_member(const int m, const generation &g) {
+  const int word = m / 64;
+  const uint64_t bit = uint64_t{1} << (m % 64);
+
+  for (int i = 0; i < field_width; ++i) {
+    uint64_t &cell = front[std::size_t(i + 1) * lanes + word];
+    const bool set = i < int(g.size()) && (g[i] & 1);
+    cell = set ? (cell | bit) : (cell & ~bit);
+  }
+
+  active[word] |= bit;
+  frozen[m] = -1;
+}
+
+qca::packed_generation qca::ensemble::packed_member(const int m) const {
+  packed_generation p{field_width, {}};
+  p.words.assign((field_width + 63) / 64, 0);
+
+  const int word = m / 64;
+  const int bit = m % 64;
+  for (int i = 0; i < field_width; ++i) {
+    const uint64_t cell = front[std::size_t(i + 1) * lanes + word];
+    p.words[i / 64] |= ((cell >> bit) & 1) << (i % 64);
+  }
+
+  return p;
+}
+
+qca::generation qca::ensemble::member(const int m) const {
+  return unpack(packed_member(m));
+}
+
+void qca::ensemble::next() {
+  if (field_width == 0) { return; }
+
+  fill_ghosts();
+
+  const std::size_t begin = lanes;
+  const std::size_t end = std::size_t(field_width + 1) * lanes;
+  active_slice_kernel()(front.data(), back.data(), begin, end, lanes, code);
+
+  // a member freezes on the first step that leaves every one of its cells
+  // alone. skipped entirely once the whole ensemble has settled.
+  if (!all_frozen()) {
+    for (int j = 0; j < lanes; ++j) {
+      if (active[j] == 0) { continue; }
+
+      uint64_t changed = 0;
+      for (std::size_t k = begin + j; k < end; k += lanes) {
+        changed |= front[k] ^ back[k];
+      }
+
+      for (uint64_t bits = active[j] & ~changed; bits; bits &= bits - 1) {
+        frozen[j * 64 + __builtin_ctzll(bits)] = gen_count;
+      }
+      active[j] &= changed;
+    }
+  }
+
+  std::swap(front, back);
+  gen_count++;
+}
+
+uint64_t qca::ensemble::generation_count() const {
+  return gen_count;
+}
+
+int qca::ensemble::size() const {
+  return lanes * 64;
+}
+
+std::vector<double> qca::ensemble::density() const {
+  std::vector<uint64_t> counts(size(), 0);
+
+  for (int i = 1; i <= field_width; ++i) {
+    for (int j = 0; j < lanes; ++j) {
+      const uint64_t cell = front[std::size_t(i) * lanes + j];
+      for (uint64_t bits = cell; bits != 0; bits &= bits - 1) {
+        counts[j * 64 + __builtin_ctzll(bits)]++;
+      }
+    }
+  }
+
+  std::vector<double> fractions(size(), 0.0);
+  for (int m = 0; m < size(); ++m) {
+    fractions[m] = field_width ? double(counts[m]) / field_width : 0.0;
+  }
+
+  return fractions;
+}
+
+double qca::ensemble::mean_density() const {
+  uint64_t count = 0;
+  for (std::size_t k = lanes; k < front.size() - lanes; ++k) {
+    count += __builtin_popcountll(front[k]);
+  }
+
+  const double cells = double(field_width) * size();
+  return cells > 0 ? count / cells : 0.0;
+}
+
+const std::vector<int64_t> &qca::ensemble::frozen_at() const {
+  return frozen;
+}
+
+bool qca::ensemble::all_frozen() const {
+  return std::all_of(active.begin(), active.end(), [](const uint64_t a) {
+    return a == 0;
+  });
+}
+
+void qca::ensemble::fill_ghosts() {
+  uint64_t *left = front.data();
+  uint64_t *right = front.data() + std::size_t(field_width + 1) * lanes;
+  const uint64_t *first = left + lanes;
+  const uint64_t *last = right - lanes;
+
+  for (int j = 0; j < lanes; ++j) {
+    switch (edges) {
+      case boundary::zero:
+        left[j] = right[j] = 0;
+        break;
+      case boundary::one:
+        left[j] = right[j] = ~uint64_t{0};
+        break;
+      case boundary::periodic:
+        left[j] = last[j];
+        right[j] = first[j];
+        break;
+      case boundary::reflect:
+        left[j] = first[j];
+        right[j] = last[j];
+        break;
+    }
+  }
+}
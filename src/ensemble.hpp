@@ -0,0 +1,64 @@
+#ifndef __ENSEMBLE_HPP__
+#define __ENSEMBLE_HPP__
+#include <cstdint>
+#include <random>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+namespace qca {
+  // evolves many independent rows of one elementary rule together.
+  //
+  // the rows are bit-sliced across the members: every cell is `size() / 64`
+  // words, bit m of the cell holding member m's state. a cell's neighbours are
+  // the words of the cells next to it, so one boolean evaluation per word steps
+  // 64 members and the vector kernels step 256 or 512 per instruction.
+  class ensemble {
+  public:
+    // members is rounded up to a multiple of 64
+    ensemble(
+      const int w, const rule_set &r, const int members=64,
+      const boundary b=boundary::zero
+    );
+
+    // every member gets its own uniformly random row
+    void init_random();
+    void set_member(const int m, const generation &g);
+    generation member(const int m) const;
+    packed_generation packed_member(const int m) const;
+
+    void next();
+    uint64_t generation_count() const;
+    int size() const;
+
+    // fraction of cells set in each member, and over the whole ensemble
+    std::vector<double> density() const;
+    double mean_density() const;
+
+    // for each member the first generation t whose successor equals it, or
+    // -1 while the member is still changing. a row that repeats itself once
+    // repeats forever, so the value never changes after it is set.
+    const std::vector<int64_t> &frozen_at() const;
+    bool all_frozen() const;
+
+    const int field_width;
+  private:
+    void fill_ghosts();
+
+    // a ghost cell either side, next() writes back from front and swaps them
+    std::vector<uint64_t> front;
+    std::vector<uint64_t> back;
+    // bit m is set while member m has not frozen
+    std::vector<uint64_t> active;
+    std::vector<int64_t> frozen;
+    const int lanes;
+    const uint8_t code;
+    const boundary edges;
+    uint64_t gen_count = 0;
+
+    std::mt19937_64 engine;
+  };
+}
+
+#endif // __ENSEMBLE_HPP__
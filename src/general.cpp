@@ -0,0 +1,297 @@
+#include <algorithm>
+#include <charconv>
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+#include "general.hpp"
+
+static std::size_t table_size(const int k, const int r) {
+  std::size_t size = 1;
+  for (int i = 0; i < 2 * r + 1; ++i) {
+    size *= k;
+  }
+
+  return size;
+}
+
+static std::optional<uint64_t> parse_number(const std::string_view s) {
+  uint64_t n = 0;
+  const auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), n);
+  if (error != std::errc{} || end != s.data() + s.size()) {
+    return std::nullopt;
+  }
+
+  return n;
+}
+
+qca::rule_table qca::wolfram_table(const uint8_t code) {
+  rule_table t{2, 1, {}};
+  for (int n = 0; n < 8; ++n) {
+    t.table.push_back((code >> n) & 1);
+  }
+
+  return t;
+}
+
+bool qca::is_elementary(const rule_table &t) {
+  return t.states == 2 && t.radius == 1;
+}
+
+uint8_t qca::elementary_code(const rule_table &t) {
+  uint8_t code = 0;
+  for (int n = 0; n < 8; ++n) {
+    code |= (t.table[n] & 1) << n;
+  }
+
+  return code;
+}
+
+std::optional<qca::rule_table> qca::parse_rule(const std::string_view spec) {
+  if (const auto code = parse_number(spec)) {
+    if (*code > 255) { return std::nullopt; }
+    return wolfram_table(*code);
+  }
+
+  rule_table t{0, -1, {}};
+  std::string_view kind;
+  std::string_view value;
+
+  std::string_view rest = spec;
+  while (!rest.empty()) {
+    const std::size_t comma = rest.find(',');
+    const std::string_view field = rest.substr(0, comma);
+    rest = (comma == std::string_view::npos) ? "" : rest.substr(comma + 1);
+
+    const std::size_t equals = field.find('=');
+    if (equals == std::string_view::npos) { return std::nullopt; }
+
+    const std::string_view key = field.substr(0, equals);
+    const std::string_view v = field.substr(equals + 1);
+
+    if (key == "k" || key == "r") {
+      const auto n = parse_number(v);
+      if (!n || *n > max_states) { return std::nullopt; }
+      (key == "k" ? t.states : t.radius) = *n;
+    } else if (kind.empty()) {
+      kind = key;
+      value = v;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  if (t.states < 2 || t.radius < 0 || t.radius > max_radius) {
+    return std::nullopt;
+  }
+
+  const int k = t.states;
+  const std::size_t size = table_size(k, t.radius);
+  t.table.resize(size, 0);
+
+  if (kind == "code") {
+    auto n = parse_number(value);
+    if (!n) { return std::nullopt; }
+
+    for (std::size_t i = 0; i < size && *n != 0; ++i) {
+      t.table[i] = *n % k;
+      *n /= k;
+    }
+    if (*n != 0) { return std::nullopt; }
+  } else if (kind == "totalistic") {
+    const auto n = parse_number(value);
+    if (!n) { return std::nullopt; }
+
+    for (std::size_t i = 0; i < size; ++i) {
+      int sum = 0;
+      for (std::size_t j = i; j != 0; j /= k) {
+        sum += j % k;
+      }
+
+      uint64_t digits = *n;
+      for (int d = 0; d < sum; ++d) {
+        digits /= k;
+      }
+      t.table[i] = digits % k;
+    }
+  } else if (kind == "table") {
+    if (value.size() != size) { return std::nullopt; }
+
+    for (std::size_t i = 0; i < size; ++i) {
+      const int digit = value[i] - '0';
+      if (digit < 0 || digit >= k) { return std::nullopt; }
+      t.table[size - 1 - i] = digit;
+    }
+  } else if (kind == "random") {
+    const auto seed = parse_number(value);
+    if (!seed) { return std::nullopt; }
+
+    std::mt19937 engine(*seed);
+    std::uniform_int_distribution d{0, k - 1};
+    for (auto &entry : t.table) {
+      entry = d(engine);
+    }
+  } else {
+    return std::nullopt;
+  }
+
+  return t;
+}
+
+qca::general::general(
+  const int w, const int h, const rule_table &r, const boundary b
+) : field_width(w), field_height(h), rules(r), edges(b) {
+  engine.seed(std::random_device{}());
+  init_single_1();
+}
+
+void qca::general::init_single_0() {
+  reset();
+  const int r = working_rules.radius;
+  front.assign(field_width + 2 * r + 1, 1);
+  back.assign(front.size(), 0);
+
+  front[r + field_width / 2] = 0;
+}
+
+void qca::general::init_single_1() {
+  reset();
+  const int r = working_rules.radius;
+  front.assign(field_width + 2 * r + 1, 0);
+  back.assign(front.size(), 0);
+
+  front[r + field_width / 2] = 1;
+}
+
+void qca::general::init_alternate() {
+  reset();
+  const int r = working_rules.radius;
+  front.assign(field_width + 2 * r + 1, 0);
+  back.assign(front.size(), 0);
+
+  for (int i = 0; i < field_width; ++i) {
+    front[r + i] = i % 2;
+  }
+}
+
+void qca::general::init_random() {
+  reset();
+  const int r = working_rules.radius;
+  front.assign(field_width + 2 * r + 1, 0);
+  back.assign(front.size(), 0);
+  std::uniform_int_distribution d{0, working_rules.states - 1};
+
+  for (int i = 0; i < field_width; ++i) {
+    front[r + i] = d(engine);
+  }
+}
+
+void qca::general::init(const init_mode m) {
+  switch (m) {
+    case init_mode::single_0: init_single_0(); break;
+    case init_mode::single_1: init_single_1(); break;
+    case init_mode::alternate: init_alternate(); break;
+    case init_mode::random: init_random(); break;
+  }
+}
+
+void qca::general::set_rules(const rule_table &r) {
+  rules = r;
+}
+
+void qca::general::set_palette(const palette &p) {
+  colours = p;
+}
+
+const qca::palette &qca::general::get_palette() const {
+  return colours;
+}
+
+void qca::general::set_boundary(const boundary b) {
+  edges = b;
+}
+
+qca::generation qca::general::get() const {
+  generation g;
+  if (front.empty()) { return g; }
+
+  const auto cells = front.begin() + working_rules.radius;
+  g.assign(cells, cells + field_width);
+
+  return g;
+}
+
+void qca::general::next() {
+  if (front.empty()) { return; }
+
+  fill_ghosts();
+
+  const int k = working_rules.states;
+  const int span = 2 * working_rules.radius + 1;
+  const uint32_t top = working_rules.table.size();
+  const uint8_t *table = working_rules.table.data();
+  const uint8_t *src = front.data();
+  uint8_t *dst = back.data() + working_rules.radius;
+
+  // the index slides along the row a cell at a time: shift in the cell
+  // entering on the right and drop the one leaving on the left, instead of
+  // rebuilding all 2r+1 digits for every cell
+  uint32_t index = 0;
+  for (int j = 0; j < span; ++j) {
+    index = index * k + src[j];
+  }
+
+  for (int i = 0; i < field_width; ++i) {
+    dst[i] = table[index];
+    index = index * k - src[i] * top + src[i + span];
+  }
+
+  std::swap(front, back);
+}
+
+void qca::general::reset() {
+  front.clear();
+  back.clear();
+  working_rules = rules;
+  working_edges = edges;
+
+  // a palette too short for the new rule goes back to the default
+  if (int(colours.size()) < working_rules.states) {
+    colours = greyscale(working_rules.states);
+  }
+}
+
+void qca::general::fill_ghosts() {
+  const int r = working_rules.radius;
+  const int w = field_width;
+  uint8_t *cells = front.data() + r;
+
+  for (int j = 1; j <= r; ++j) {
+    uint8_t left = 0;
+    uint8_t right = 0;
+
+    switch (working_edges) {
+      case boundary::zero: break;
+      case boundary::one:
+        left = 1;
+        right = 1;
+        break;
+      case boundary::periodic:
+        left = cells[((w - j) % w + w) % w];
+        right = cells[(j - 1) % w];
+        break;
+      case boundary::reflect:
+        left = cells[std::min(j - 1, w - 1)];
+        right = cells[std::max(w - j, 0)];
+        break;
+    }
+
+    cells[-j] = left;
+    cells[w - 1 + j] = right;
+  }
+}
@@ -0,0 +1,82 @@
+#ifndef __GENERAL_HPP__
+#define __GENERAL_HPP__
+#include <cstdint>
+#include <optional>
+#include <random>
+#include <string_view>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+namespace qca {
+  constexpr int max_states = 4;
+  constexpr int max_radius = 3;
+
+  // rule for k states and radius r. the table has k^(2r+1) entries indexed by
+  // the neighbourhood read as a base k number, leftmost cell most significant,
+  // so k = 2, r = 1 is indexed exactly like a wolfram code.
+  struct rule_table {
+    int states = 2;
+    int radius = 1;
+    std::vector<uint8_t> table;
+  };
+
+  rule_table wolfram_table(const uint8_t code);
+  bool is_elementary(const rule_table &t);
+  uint8_t elementary_code(const rule_table &t);
+
+  // parses a rule spec, one of
+  //   "30"                     wolfram code
+  //   "k=3,r=1,code=N"         table as the base k digits of N
+  //   "k=3,r=1,totalistic=N"   entry for neighbourhood sum s is digit s of N
+  //   "k=2,r=2,table=0110..."  every base k digit, highest neighbourhood first
+  //   "k=4,r=3,random=SEED"    random table
+  std::optional<rule_table> parse_rule(const std::string_view spec);
+
+  // radius r, k state automaton on the same generation/colour pipeline as
+  // qca::elementary, drawn with greyscale(k) unless given a palette
+  class general {
+  public:
+    general() = default;
+    general(
+      const int w, const int h, const rule_table &r,
+      const boundary b=boundary::zero
+    );
+
+    void init_single_0();
+    void init_single_1();
+    void init_alternate();
+    void init_random();
+    void init(const init_mode m);
+    void set_rules(const rule_table &r);
+    // applies straight away, see reset() for rules with more states
+    void set_palette(const palette &p);
+    const palette &get_palette() const;
+    void set_boundary(const boundary b);
+
+    generation get() const;
+    void next();
+    void reset();
+
+    int field_width;
+    int field_height;
+  private:
+    void fill_ghosts();
+
+    // states with `radius` ghost cells either side plus one spare cell on the
+    // right for the index to slide onto, next() writes back from front and
+    // swaps them
+    std::vector<uint8_t> front;
+    std::vector<uint8_t> back;
+    rule_table rules;
+    rule_table working_rules;
+    boundary edges = boundary::zero;
+    boundary working_edges = boundary::zero;
+    palette colours;
+
+    std::mt19937 engine;
+  };
+}
+
+#endif // __GENERAL_HPP__
@@ -0,0 +1,270 @@
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "elementary.hpp"
+#include "hashlife.hpp"
+
+static constexpr int min_level = 3;
+
+qca::hashlife::hashlife(const rule_set &r) : code(rule_code(r)) {
+  // the two level 0 nodes are single cells, their id is their state
+  nodes.push_back({no_node, no_node, 0});
+  nodes.push_back({no_node, no_node, 0});
+  uniform_nodes[0].push_back(0);
+  uniform_nodes[1].push_back(1);
+
+  init({});
+}
+
+void qca::hashlife::init(const generation &g, const uint8_t background) {
+  initial = g;
+  initial_background = background & 1;
+
+  this->background = initial_background;
+  origin = 0;
+  gen_count = 0;
+  build(pack(g));
+}
+
+void qca::hashlife::advance(const uint64_t n) {
+  for (int j = 63; j >= 0; --j) {
+    if ((n >> j) & 1) {
+      step(j);
+    }
+  }
+}
+
+uint64_t qca::hashlife::generation_count() const {
+  return gen_count;
+}
+
+qca::generation qca::hashlife::row(const int64_t left, const int width) const {
+  packed_generation out{width, {}};
+  out.words.assign((width + 63) / 64, background ? ~uint64_t{0} : 0);
+
+  read(root, origin, left, width, out);
+
+  if (width % 64 != 0) {
+    out.words.back() &= (uint64_t{1} << (width % 64)) - 1;
+  }
+
+  return unpack(out);
+}
+
+qca::generation qca::hashlife::read_row(
+  const uint64_t n, const int64_t left, const int width
+) {
+  if (n < gen_count) {
+    const generation g = initial;
+    init(g, initial_background);
+  }
+
+  advance(n - gen_count);
+  return row(left, width);
+}
+
+std::size_t qca::hashlife::node_count() const {
+  return nodes.size();
+}
+
+qca::hashlife::node_id qca::hashlife::join(const node_id l, const node_id r) {
+  const uint64_t key = (uint64_t{l} << 32) | r;
+
+  const auto it = joined.find(key);
+  if (it != joined.end()) {
+    return it->second;
+  }
+
+  const node_id id = nodes.size();
+  nodes.push_back({l, r, nodes[l].level + 1});
+  joined.emplace(key, id);
+
+  return id;
+}
+
+qca::hashlife::node_id qca::hashlife::uniform(
+  const int level, const uint8_t state
+) {
+  std::vector<node_id> &u = uniform_nodes[state];
+  while (static_cast<int>(u.size()) <= level) {
+    u.push_back(join(u.back(), u.back()));
+  }
+
+  return u[level];
+}
+
+// centre 2^(k-1) cells of a level k node after 2^j generations, j <= k - 2.
+//
+// the node is split into three overlapping level k-1 nodes, each advanced
+// 2^j generations (or 2^(k-3) when j is the full k-2) to level k-2 results.
+// a full step then advances the two level k-1 nodes formed from neighbouring
+// results by another 2^(k-3), a partial step just takes their centres.
+qca::hashlife::node_id qca::hashlife::successor(const node_id n, const int j) {
+  const int k = nodes[n].level;
+  const bool full = (j == k - 2);
+  const uint64_t key = (uint64_t{n} << 8) | j;
+
+  if (full && nodes[n].next != no_node) {
+    return nodes[n].next;
+  }
+
+  if (!full) {
+    const auto it = partial.find(key);
+    if (it != partial.end()) {
+      return it->second;
+    }
+  }
+
+  const node_id a = nodes[n].left;
+  const node_id b = nodes[n].right;
+  node_id result;
+
+  if (k == 2) {
+    const int c0 = nodes[a].left;
+    const int c1 = nodes[a].right;
+    const int c2 = nodes[b].left;
+    const int c3 = nodes[b].right;
+
+    result = join(
+      (code >> ((c0 << 2) | (c1 << 1) | c2)) & 1,
+      (code >> ((c1 << 2) | (c2 << 1) | c3)) & 1
+    );
+  } else {
+    const node_id mid = join(nodes[a].right, nodes[b].left);
+    const int inner = full ? k - 3 : j;
+
+    const node_id r0 = successor(a, inner);
+    const node_id r1 = successor(mid, inner);
+    const node_id r2 = successor(b, inner);
+
+    if (full) {
+      const node_id left = successor(join(r0, r1), k - 3);
+      const node_id right = successor(join(r1, r2), k - 3);
+      result = join(left, right);
+    } else {
+      result = join(
+        join(nodes[r0].right, nodes[r1].left),
+        join(nodes[r1].right, nodes[r2].left)
+      );
+    }
+  }
+
+  if (full) {
+    nodes[n].next = result;
+  } else {
+    partial.emplace(key, result);
+  }
+
+  return result;
+}
+
+void qca::hashlife::build(const packed_generation &p) {
+  int level = min_level;
+  while ((int64_t{1} << level) < p.width) {
+    level++;
+  }
+
+  std::vector<node_id> row(std::size_t{1} << level, background);
+  for (int i = 0; i < p.width; ++i) {
+    row[i] = (p.words[i / 64] >> (i % 64)) & 1;
+  }
+
+  while (row.size() > 1) {
+    for (std::size_t i = 0; i < row.size() / 2; ++i) {
+      row[i] = join(row[2 * i], row[2 * i + 1]);
+    }
+    row.resize(row.size() / 2);
+  }
+
+  root = row[0];
+}
+
+// doubles the root, keeping the current root as its centre half
+void qca::hashlife::expand() {
+  const int k = nodes[root].level;
+  const node_id u = uniform(k - 1, background);
+  const node_id a = nodes[root].left;
+  const node_id b = nodes[root].right;
+
+  root = join(join(u, a), join(b, u));
+  origin -= int64_t{1} << (k - 1);
+}
+
+// halves the root while everything outside its centre half is background
+void qca::hashlife::shrink() {
+  while (nodes[root].level > min_level && is_padded(root)) {
+    const int k = nodes[root].level;
+    root = join(nodes[nodes[root].left].right, nodes[nodes[root].right].left);
+    origin += int64_t{1} << (k - 2);
+  }
+}
+
+bool qca::hashlife::is_padded(const node_id n) {
+  const node_id u = uniform(nodes[n].level - 2, background);
+
+  return nodes[nodes[n].left].left == u && nodes[nodes[n].right].right == u;
+}
+
+void qca::hashlife::step(const int j) {
+  // pad until the pattern sits in the centre half of a root of level j + 3,
+  // then once more so its growth over 2^j generations stays inside the
+  // result, which is the centre half of the padded root
+  while (nodes[root].level < j + 3 || !is_padded(root)) {
+    expand();
+  }
+  expand();
+
+  const int k = nodes[root].level;
+  root = successor(root, j);
+  origin += int64_t{1} << (k - 2);
+
+  background = background_after(uint64_t{1} << j);
+  gen_count += uint64_t{1} << j;
+
+  shrink();
+}
+
+// the background is a uniform row so it evolves on its own, and with only two
+// states it is periodic after at most one step with a period of one or two
+uint8_t qca::hashlife::background_after(const uint64_t n) const {
+  uint8_t b = background;
+  const uint64_t steps = (n == 0) ? 0 : 1 + (n - 1) % 2;
+
+  for (uint64_t i = 0; i < steps; ++i) {
+    b = (code >> (b ? 7 : 0)) & 1;
+  }
+
+  return b;
+}
+
+void qca::hashlife::read(
+  const node_id n, const int64_t x, const int64_t left, const int width,
+  packed_generation &out
+) const {
+  const int k = nodes[n].level;
+  const int64_t size = int64_t{1} << k;
+
+  if (x >= left + width || x + size <= left) {
+    return;
+  }
+
+  const std::vector<node_id> &u = uniform_nodes[background];
+  if (static_cast<int>(u.size()) > k && u[k] == n) {
+    return;
+  }
+
+  if (k == 0) {
+    const int64_t i = x - left;
+    const uint64_t bit = uint64_t{1} << (i % 64);
+    if (n) {
+      out.words[i / 64] |= bit;
+    } else {
+      out.words[i / 64] &= ~bit;
+    }
+    return;
+  }
+
+  read(nodes[n].left, x, left, width, out);
+  read(nodes[n].right, x + size / 2, left, width, out);
+}
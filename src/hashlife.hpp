@@ -0,0 +1,81 @@
+#ifndef __HASHLIFE_HPP__
+#define __HASHLIFE_HPP__
+#include <cstdint>
+#include <unordered_map>
+#include <vector>
+
+#include "elementary.hpp"
+
+namespace qca {
+  // memoised space-time engine for elementary rules on an unbounded line.
+  //
+  // a row is a binary tree of hash-consed nodes, a node at level k covering
+  // 2^k cells. the centre 2^(k-1) cells of a node after 2^(k-2) generations
+  // depend only on that node, so they are computed once per distinct node and
+  // shared by every place that node appears in space or time. regular and
+  // nested rules (90, 150, 105, ...) reach generation 2^40 in a few thousand
+  // nodes, chaotic rules gain little and use a lot of memory.
+  class hashlife {
+  public:
+    hashlife(const rule_set &r);
+
+    // places g with its first cell at x = 0, every other cell on the line is
+    // the background state
+    void init(const generation &g, const uint8_t background=0);
+
+    void advance(const uint64_t n);
+    uint64_t generation_count() const;
+
+    // cells [left, left + width) of the current generation
+    generation row(const int64_t left, const int width) const;
+    // cells [left, left + width) of generation n, rewinding to the initial
+    // row first if n is behind the current generation
+    generation read_row(const uint64_t n, const int64_t left, const int width);
+
+    std::size_t node_count() const;
+  private:
+    using node_id = uint32_t;
+    static constexpr node_id no_node = ~node_id{0};
+
+    struct node {
+      node_id left;
+      node_id right;
+      int level;
+      // centre half after 2^(level - 2) generations
+      node_id next = no_node;
+    };
+
+    node_id join(const node_id l, const node_id r);
+    node_id uniform(const int level, const uint8_t state);
+    node_id successor(const node_id n, const int j);
+
+    void build(const packed_generation &p);
+    void expand();
+    void shrink();
+    bool is_padded(const node_id n);
+    void step(const int j);
+    uint8_t background_after(const uint64_t n) const;
+
+    void read(
+      const node_id n, const int64_t x, const int64_t left, const int width,
+      packed_generation &out
+    ) const;
+
+    uint8_t code;
+
+    std::vector<node> nodes;
+    std::unordered_map<uint64_t, node_id> joined;
+    std::unordered_map<uint64_t, node_id> partial;
+    std::vector<node_id> uniform_nodes[2];
+
+    generation initial;
+    uint8_t initial_background = 0;
+
+    node_id root = 0;
+    int64_t origin = 0;
+    uint8_t background = 0;
+    uint64_t gen_count = 0;
+  };
+}
+
+#endif // __HASHLIFE_HPP__
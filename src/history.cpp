@@ -0,0 +1,152 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+#include "history.hpp"
+#include "kernels.hpp"
+
+static constexpr uint64_t tail_mask(const int width) {
+  return (width % 64 == 0) ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1;
+}
+
+template <typename Boundary>
+static void step_rows(
+  std::vector<uint64_t> &row, std::vector<uint64_t> &scratch,
+  const int width, const uint8_t code, uint64_t n
+) {
+  const std::size_t words = row.size() - 2;
+  const qca::step_kernel kernel = qca::active_kernel();
+
+  for (; n > 0; --n) {
+    qca::boundaries::fill<Boundary>(row.data() + 1, width);
+    kernel(row.data() + 1, scratch.data() + 1, 0, words, code);
+    scratch[words] &= tail_mask(width);
+    std::swap(row, scratch);
+  }
+}
+
+qca::history_store::history_store(
+  const int width, const uint8_t code, const boundary b,
+  const std::size_t memory_cap, const uint64_t keyframe_interval
+) : field_width(width), words((width + 63) / 64), code(code), edges(b),
+    cap(memory_cap), interval(std::max<uint64_t>(keyframe_interval, 1)) {
+  // the row at() keeps and the one it steps through come out of the cap
+  // first, both have a ghost word at each end
+  const std::size_t row_bytes = std::max<std::size_t>(words, 1) * 8;
+  const std::size_t working = 2 * (words + 2) * sizeof(uint64_t);
+  const std::size_t rows_cap = (cap > working) ? cap - working : 0;
+  ring_rows = std::max<std::size_t>(rows_cap / 2 / row_bytes, 1);
+  max_keyframes = std::max<std::size_t>(rows_cap / 2 / row_bytes, 1);
+
+  ring.assign(ring_rows * words, 0);
+  keyframes.reserve(max_keyframes * words);
+}
+
+void qca::history_store::push(const packed_generation &g) {
+  if (words == 0) {
+    count++;
+    return;
+  }
+
+  const uint64_t *row = g.words.data();
+  std::copy(row, row + words, ring.begin() + (count % ring_rows) * words);
+
+  if (count % interval == 0) {
+    if (keyframes.size() / words >= max_keyframes) {
+      // keep the even keyframes, which are exactly the ones on the new
+      // interval
+      const std::size_t kept = (keyframes.size() / words + 1) / 2;
+      for (std::size_t i = 1; i < kept; ++i) {
+        std::copy_n(
+          keyframes.begin() + 2 * i * words, words,
+          keyframes.begin() + i * words
+        );
+      }
+      keyframes.resize(kept * words);
+      interval *= 2;
+    }
+
+    if (count % interval == 0) {
+      keyframes.insert(keyframes.end(), row, row + words);
+    }
+  }
+
+  count++;
+}
+
+void qca::history_store::clear() {
+  std::fill(ring.begin(), ring.end(), 0);
+  keyframes.clear();
+  count = 0;
+  has_cached = false;
+}
+
+qca::packed_generation qca::history_store::at(const uint64_t n) const {
+  if (n + ring_rows >= count) {
+    const auto slot = ring.begin() + (n % ring_rows) * words;
+    return {field_width, std::vector<uint64_t>(slot, slot + words)};
+  }
+
+  const uint64_t key = n / interval * interval;
+  if (!has_cached || cached_gen > n || cached_gen < key) {
+    const auto frame = keyframes.begin() + (key / interval) * words;
+    cached.assign(words + 2, 0);
+    std::copy(frame, frame + words, cached.begin() + 1);
+    cached_gen = key;
+    has_cached = true;
+  }
+
+  advance(cached, n - cached_gen);
+  cached_gen = n;
+
+  return from_row(cached);
+}
+
+uint64_t qca::history_store::size() const {
+  return count;
+}
+
+uint64_t qca::history_store::keyframe_interval() const {
+  return interval;
+}
+
+std::size_t qca::history_store::memory_used() const {
+  return (ring.capacity() + keyframes.capacity() + cached.capacity() +
+    scratch.capacity()) * sizeof(uint64_t);
+}
+
+std::size_t qca::history_store::memory_cap() const {
+  return cap;
+}
+
+void qca::history_store::advance(
+  std::vector<uint64_t> &row, const uint64_t n
+) const {
+  if (n == 0 || words == 0) { return; }
+  scratch.resize(row.size());
+
+  switch (edges) {
+    case boundary::zero:
+      step_rows<boundaries::zero>(row, scratch, field_width, code, n);
+      break;
+    case boundary::one:
+      step_rows<boundaries::one>(row, scratch, field_width, code, n);
+      break;
+    case boundary::periodic:
+      step_rows<boundaries::periodic>(row, scratch, field_width, code, n);
+      break;
+    case boundary::reflect:
+      step_rows<boundaries::reflect>(row, scratch, field_width, code, n);
+      break;
+  }
+}
+
+qca::packed_generation qca::history_store::from_row(
+  const std::vector<uint64_t> &row
+) const {
+  return {field_width, std::vector<uint64_t>(row.begin() + 1, row.end() - 1)};
+}
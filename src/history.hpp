@@ -0,0 +1,71 @@
+#ifndef __HISTORY_HPP__
+#define __HISTORY_HPP__
+#include <cstddef>
+#include <cstdint>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+namespace qca {
+  // the space-time diagram of one elementary run in bounded memory.
+  //
+  // rows are kept bit-packed: the most recent ones in a ring, and every
+  // `keyframe_interval()`th one as a keyframe. a row that has left the ring
+  // is recomputed by stepping on from the keyframe before it. when the
+  // keyframes outgrow their share of the cap every other one is dropped and
+  // the interval doubles, so the memory stays put and only the recompute
+  // gets longer.
+  class history_store {
+  public:
+    history_store() = default;
+    // the cap covers everything memory_used() counts. what is left after
+    // the two rows at() recomputes with goes half to the ring and half to
+    // keyframes, each holds at least one row whatever the cap
+    history_store(
+      const int width, const uint8_t code, const boundary b,
+      const std::size_t memory_cap, const uint64_t keyframe_interval=64
+    );
+
+    // appends the next generation of the run
+    void push(const packed_generation &g);
+    void clear();
+
+    // generation n, which must be below size()
+    packed_generation at(const uint64_t n) const;
+    uint64_t size() const;
+
+    uint64_t keyframe_interval() const;
+    std::size_t memory_used() const;
+    std::size_t memory_cap() const;
+
+    int field_width = 0;
+  private:
+    // steps a row with ghost words at either end on n generations
+    void advance(std::vector<uint64_t> &row, const uint64_t n) const;
+    packed_generation from_row(const std::vector<uint64_t> &row) const;
+
+    std::size_t words = 0;
+    uint8_t code = 0;
+    boundary edges = boundary::zero;
+    std::size_t cap = 0;
+
+    // generation g lives in slot g % ring_rows while g >= count - ring_rows
+    std::vector<uint64_t> ring;
+    std::size_t ring_rows = 0;
+    // keyframe i is generation i * interval
+    std::vector<uint64_t> keyframes;
+    std::size_t max_keyframes = 0;
+    uint64_t interval = 64;
+    uint64_t count = 0;
+
+    // the last row recomputed, so reading forward through evicted rows steps
+    // one generation per row instead of starting over from the keyframe
+    mutable std::vector<uint64_t> cached;
+    mutable std::vector<uint64_t> scratch;
+    mutable uint64_t cached_gen = 0;
+    mutable bool has_cached = false;
+  };
+}
+
+#endif // __HISTORY_HPP__
@@ -0,0 +1,382 @@
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdlib>
+#include <iostream>
+#include <string_view>
+#include <utility>
+
+#include "kernels.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QCA_X86
+#include <immintrin.h>
+#endif
+
+static inline uint64_t step_word(
+  const uint64_t *src, const std::size_t i, const uint8_t code
+) {
+  const uint64_t left = (src[i] << 1) | (src[i - 1] >> 63);
+  const uint64_t right = (src[i] >> 1) | (src[i + 1] << 63);
+
+  return qca::apply_rule(code, left, src[i], right);
+}
+
+static void step_scalar(
+  const uint64_t *src, uint64_t *dst,
+  const std::size_t begin, const std::size_t end, const uint8_t code
+) {
+  for (std::size_t i = begin; i < end; ++i) {
+    dst[i] = step_word(src, i, code);
+  }
+}
+
+static void slice_scalar(
+  const uint64_t *src, uint64_t *dst, const std::size_t begin,
+  const std::size_t end, const std::size_t stride, const uint8_t code
+) {
+  for (std::size_t i = begin; i < end; ++i) {
+    dst[i] = qca::apply_rule(code, src[i - stride], src[i], src[i + stride]);
+  }
+}
+
+#ifdef QCA_X86
+// the vector kernels split the rule on the left cell,
+//   result = l ? g1(c, r) : g0(c, r)
+// with g0/g1 built from the four (c, r) minterms and a broadcast mask per
+// code bit, so any code costs the same and nothing branches on it.
+
+__attribute__((target("sse2")))
+static inline __m128i rule_sse2(
+  const __m128i l, const __m128i c, const __m128i r, const __m128i *m
+) {
+  const __m128i cr = _mm_and_si128(c, r);
+  const __m128i c_nr = _mm_andnot_si128(r, c);
+  const __m128i nc_r = _mm_andnot_si128(c, r);
+  const __m128i nc_nr = _mm_andnot_si128(_mm_or_si128(c, r), m[8]);
+
+  const __m128i g0 = _mm_or_si128(
+    _mm_or_si128(_mm_and_si128(cr, m[3]), _mm_and_si128(c_nr, m[2])),
+    _mm_or_si128(_mm_and_si128(nc_r, m[1]), _mm_and_si128(nc_nr, m[0]))
+  );
+  const __m128i g1 = _mm_or_si128(
+    _mm_or_si128(_mm_and_si128(cr, m[7]), _mm_and_si128(c_nr, m[6])),
+    _mm_or_si128(_mm_and_si128(nc_r, m[5]), _mm_and_si128(nc_nr, m[4]))
+  );
+
+  return _mm_xor_si128(g0, _mm_and_si128(l, _mm_xor_si128(g0, g1)));
+}
+
+// m[0..7] are the code bits, m[8] is all ones
+__attribute__((target("sse2")))
+static inline void masks_sse2(const uint8_t code, __m128i *m) {
+  for (int b = 0; b < 8; ++b) {
+    m[b] = _mm_set1_epi64x(-static_cast<int64_t>((code >> b) & 1));
+  }
+  m[8] = _mm_set1_epi64x(-1);
+}
+
+__attribute__((target("sse2")))
+static void step_sse2(
+  const uint64_t *src, uint64_t *dst,
+  const std::size_t begin, const std::size_t end, const uint8_t code
+) {
+  constexpr std::size_t lanes = 2;
+  __m128i m[9];
+  masks_sse2(code, m);
+
+  std::size_t i = begin;
+  for (; i + lanes <= end; i += lanes) {
+    const __m128i prev = _mm_loadu_si128((const __m128i *)(src + i - 1));
+    const __m128i c = _mm_loadu_si128((const __m128i *)(src + i));
+    const __m128i next = _mm_loadu_si128((const __m128i *)(src + i + 1));
+
+    const __m128i l = _mm_or_si128(
+      _mm_slli_epi64(c, 1), _mm_srli_epi64(prev, 63)
+    );
+    const __m128i r = _mm_or_si128(
+      _mm_srli_epi64(c, 1), _mm_slli_epi64(next, 63)
+    );
+
+    _mm_storeu_si128((__m128i *)(dst + i), rule_sse2(l, c, r, m));
+  }
+
+  for (; i < end; ++i) {
+    dst[i] = step_word(src, i, code);
+  }
+}
+
+__attribute__((target("sse2")))
+static void slice_sse2(
+  const uint64_t *src, uint64_t *dst, const std::size_t begin,
+  const std::size_t end, const std::size_t stride, const uint8_t code
+) {
+  constexpr std::size_t lanes = 2;
+  __m128i m[9];
+  masks_sse2(code, m);
+
+  std::size_t i = begin;
+  for (; i + lanes <= end; i += lanes) {
+    const __m128i l = _mm_loadu_si128((const __m128i *)(src + i - stride));
+    const __m128i c = _mm_loadu_si128((const __m128i *)(src + i));
+    const __m128i r = _mm_loadu_si128((const __m128i *)(src + i + stride));
+
+    _mm_storeu_si128((__m128i *)(dst + i), rule_sse2(l, c, r, m));
+  }
+
+  for (; i < end; ++i) {
+    dst[i] = qca::apply_rule(code, src[i - stride], src[i], src[i + stride]);
+  }
+}
+
+__attribute__((target("avx2")))
+static inline __m256i rule_avx2(
+  const __m256i l, const __m256i c, const __m256i r, const __m256i *m
+) {
+  const __m256i cr = _mm256_and_si256(c, r);
+  const __m256i c_nr = _mm256_andnot_si256(r, c);
+  const __m256i nc_r = _mm256_andnot_si256(c, r);
+  const __m256i nc_nr = _mm256_andnot_si256(_mm256_or_si256(c, r), m[8]);
+
+  const __m256i g0 = _mm256_or_si256(
+    _mm256_or_si256(_mm256_and_si256(cr, m[3]), _mm256_and_si256(c_nr, m[2])),
+    _mm256_or_si256(_mm256_and_si256(nc_r, m[1]), _mm256_and_si256(nc_nr, m[0]))
+  );
+  const __m256i g1 = _mm256_or_si256(
+    _mm256_or_si256(_mm256_and_si256(cr, m[7]), _mm256_and_si256(c_nr, m[6])),
+    _mm256_or_si256(_mm256_and_si256(nc_r, m[5]), _mm256_and_si256(nc_nr, m[4]))
+  );
+
+  return _mm256_xor_si256(g0, _mm256_and_si256(l, _mm256_xor_si256(g0, g1)));
+}
+
+__attribute__((target("avx2")))
+static inline void masks_avx2(const uint8_t code, __m256i *m) {
+  for (int b = 0; b < 8; ++b) {
+    m[b] = _mm256_set1_epi64x(-static_cast<int64_t>((code >> b) & 1));
+  }
+  m[8] = _mm256_set1_epi64x(-1);
+}
+
+__attribute__((target("avx2")))
+static void step_avx2(
+  const uint64_t *src, uint64_t *dst,
+  const std::size_t begin, const std::size_t end, const uint8_t code
+) {
+  constexpr std::size_t lanes = 4;
+  __m256i m[9];
+  masks_avx2(code, m);
+
+  std::size_t i = begin;
+  for (; i + lanes <= end; i += lanes) {
+    const __m256i prev = _mm256_loadu_si256((const __m256i *)(src + i - 1));
+    const __m256i c = _mm256_loadu_si256((const __m256i *)(src + i));
+    const __m256i next = _mm256_loadu_si256((const __m256i *)(src + i + 1));
+
+    const __m256i l = _mm256_or_si256(
+      _mm256_slli_epi64(c, 1), _mm256_srli_epi64(prev, 63)
+    );
+    const __m256i r = _mm256_or_si256(
+      _mm256_srli_epi64(c, 1), _mm256_slli_epi64(next, 63)
+    );
+
+    _mm256_storeu_si256((__m256i *)(dst + i), rule_avx2(l, c, r, m));
+  }
+
+  for (; i < end; ++i) {
+    dst[i] = step_word(src, i, code);
+  }
+}
+
+__attribute__((target("avx2")))
+static void slice_avx2(
+  const uint64_t *src, uint64_t *dst, const std::size_t begin,
+  const std::size_t end, const std::size_t stride, const uint8_t code
+) {
+  constexpr std::size_t lanes = 4;
+  __m256i m[9];
+  masks_avx2(code, m);
+
+  std::size_t i = begin;
+  for (; i + lanes <= end; i += lanes) {
+    const __m256i l = _mm256_loadu_si256((const __m256i *)(src + i - stride));
+    const __m256i c = _mm256_loadu_si256((const __m256i *)(src + i));
+    const __m256i r = _mm256_loadu_si256((const __m256i *)(src + i + stride));
+
+    _mm256_storeu_si256((__m256i *)(dst + i), rule_avx2(l, c, r, m));
+  }
+
+  for (; i < end; ++i) {
+    dst[i] = qca::apply_rule(code, src[i - stride], src[i], src[i + stride]);
+  }
+}
+
+// vpternlogq takes the truth table of any three input boolean function as an
+// immediate, and its (a << 2 | b << 1 | c) indexing matches the wolfram code
+// exactly. the immediate has to be a constant, hence one instance per code.
+template <uint8_t Code>
+__attribute__((target("avx512f")))
+static void step_avx512(
+  const uint64_t *src, uint64_t *dst,
+  const std::size_t begin, const std::size_t end, const uint8_t code
+) {
+  constexpr std::size_t lanes = 8;
+
+  std::size_t i = begin;
+  for (; i + lanes <= end; i += lanes) {
+    const __m512i prev = _mm512_loadu_si512(src + i - 1);
+    const __m512i c = _mm512_loadu_si512(src + i);
+    const __m512i next = _mm512_loadu_si512(src + i + 1);
+
+    const __m512i l = _mm512_or_si512(
+      _mm512_slli_epi64(c, 1), _mm512_srli_epi64(prev, 63)
+    );
+    const __m512i r = _mm512_or_si512(
+      _mm512_srli_epi64(c, 1), _mm512_slli_epi64(next, 63)
+    );
+
+    _mm512_storeu_si512(dst + i, _mm512_ternarylogic_epi64(l, c, r, Code));
+  }
+
+  for (; i < end; ++i) {
+    dst[i] = step_word(src, i, code);
+  }
+}
+
+template <uint8_t Code>
+__attribute__((target("avx512f")))
+static void slice_avx512(
+  const uint64_t *src, uint64_t *dst, const std::size_t begin,
+  const std::size_t end, const std::size_t stride, const uint8_t code
+) {
+  constexpr std::size_t lanes = 8;
+
+  std::size_t i = begin;
+  for (; i + lanes <= end; i += lanes) {
+    const __m512i l = _mm512_loadu_si512(src + i - stride);
+    const __m512i c = _mm512_loadu_si512(src + i);
+    const __m512i r = _mm512_loadu_si512(src + i + stride);
+
+    _mm512_storeu_si512(dst + i, _mm512_ternarylogic_epi64(l, c, r, Code));
+  }
+
+  for (; i < end; ++i) {
+    dst[i] = qca::apply_rule(code, src[i - stride], src[i], src[i + stride]);
+  }
+}
+
+template <std::size_t... Codes>
+static constexpr std::array<qca::step_kernel, 256> make_avx512_table(
+  std::index_sequence<Codes...>
+) {
+  return {{&step_avx512<static_cast<uint8_t>(Codes)>...}};
+}
+
+template <std::size_t... Codes>
+static constexpr std::array<qca::slice_kernel, 256> make_slice_avx512_table(
+  std::index_sequence<Codes...>
+) {
+  return {{&slice_avx512<static_cast<uint8_t>(Codes)>...}};
+}
+
+static void step_avx512_dispatch(
+  const uint64_t *src, uint64_t *dst,
+  const std::size_t begin, const std::size_t end, const uint8_t code
+) {
+  static constexpr std::array<qca::step_kernel, 256> table =
+    make_avx512_table(std::make_index_sequence<256>{});
+
+  table[code](src, dst, begin, end, code);
+}
+
+static void slice_avx512_dispatch(
+  const uint64_t *src, uint64_t *dst, const std::size_t begin,
+  const std::size_t end, const std::size_t stride, const uint8_t code
+) {
+  static constexpr std::array<qca::slice_kernel, 256> table =
+    make_slice_avx512_table(std::make_index_sequence<256>{});
+
+  table[code](src, dst, begin, end, stride, code);
+}
+#endif // QCA_X86
+
+bool qca::isa_supported(const isa i) {
+  switch (i) {
+    case isa::scalar: return true;
+#ifdef QCA_X86
+    case isa::sse2: return __builtin_cpu_supports("sse2");
+    case isa::avx2: return __builtin_cpu_supports("avx2");
+    case isa::avx512: return __builtin_cpu_supports("avx512f");
+#endif
+    default: return false;
+  }
+}
+
+const char *qca::isa_name(const isa i) {
+  switch (i) {
+    case isa::sse2: return "sse2";
+    case isa::avx2: return "avx2";
+    case isa::avx512: return "avx512";
+    default: return "scalar";
+  }
+}
+
+qca::isa qca::detect_isa() {
+  static constexpr isa tiers[] = {
+    isa::avx512, isa::avx2, isa::sse2, isa::scalar
+  };
+
+  const char *forced = std::getenv("QCA_ISA");
+  if (forced != nullptr) {
+    for (const isa i : tiers) {
+      if (std::string_view(forced) == isa_name(i) && isa_supported(i)) {
+        return i;
+      }
+    }
+
+    std::cerr << "QCA_ISA=" << forced << " is not available, ignoring\n";
+  }
+
+  for (const isa i : tiers) {
+    if (isa_supported(i)) { return i; }
+  }
+
+  return isa::scalar;
+}
+
+qca::step_kernel qca::get_kernel(const isa i) {
+  switch (i) {
+#ifdef QCA_X86
+    case isa::sse2: return step_sse2;
+    case isa::avx2: return step_avx2;
+    case isa::avx512: return step_avx512_dispatch;
+#endif
+    default: return step_scalar;
+  }
+}
+
+qca::isa qca::active_isa() {
+  static const isa i = detect_isa();
+  return i;
+}
+
+qca::step_kernel qca::active_kernel() {
+  static const step_kernel k = get_kernel(active_isa());
+  return k;
+}
+
+qca::slice_kernel qca::get_slice_kernel(const isa i) {
+  switch (i) {
+#ifdef QCA_X86
+    case isa::sse2: return slice_sse2;
+    case isa::avx2: return slice_avx2;
+    case isa::avx512: return slice_avx512_dispatch;
+#endif
+    default: return slice_scalar;
+  }
+}
+
+qca::slice_kernel qca::active_slice_kernel() {
+  static const slice_kernel k = get_slice_kernel(active_isa());
+  return k;
+}
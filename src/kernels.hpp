@@ -0,0 +1,57 @@
+#ifndef __KERNELS_HPP__
+#define __KERNELS_HPP__
+#include <cstddef>
+#include <cstdint>
+
+namespace qca {
+  enum class isa { scalar, sse2, avx2, avx512 };
+
+  // computes words [begin, end) of the next generation from src into dst.
+  // src must be readable one word either side of the range, rows keep a
+  // ghost word at each end so the kernels never test for the edges.
+  // disjoint ranges can run concurrently as src is only read.
+  using step_kernel = void (*)(
+    const uint64_t *src, uint64_t *dst,
+    const std::size_t begin, const std::size_t end, const uint8_t code
+  );
+
+  // computes words [begin, end) of the next generation of a bit-sliced row,
+  // where each word holds one cell of 64 independent rows and a cell's
+  // neighbours are the words `stride` either side. src must be readable
+  // `stride` words either side of the range.
+  using slice_kernel = void (*)(
+    const uint64_t *src, uint64_t *dst, const std::size_t begin,
+    const std::size_t end, const std::size_t stride, const uint8_t code
+  );
+
+  // evaluates the rule on 64 cells at once, every neighbourhood whose bit is
+  // set in the code contributes its minterm to the result
+  inline uint64_t apply_rule(
+    const uint8_t code, const uint64_t l, const uint64_t c, const uint64_t r
+  ) {
+    uint64_t result = 0;
+    for (int n = 0; n < 8; ++n) {
+      if (code & (1 << n)) {
+        result |= ((n & 4) ? l : ~l) & ((n & 2) ? c : ~c) & ((n & 1) ? r : ~r);
+      }
+    }
+
+    return result;
+  }
+
+  // best isa supported by this cpu, or the one named by the QCA_ISA
+  // environment variable (scalar, sse2, avx2, avx512) if the cpu supports it
+  isa detect_isa();
+  bool isa_supported(const isa i);
+  const char *isa_name(const isa i);
+
+  step_kernel get_kernel(const isa i);
+  slice_kernel get_slice_kernel(const isa i);
+
+  // kernels for detect_isa(), chosen once on first use
+  isa active_isa();
+  step_kernel active_kernel();
+  slice_kernel active_slice_kernel();
+}
+
+#endif // __KERNELS_HPP__
@@ -10,39 +10,46 @@ struct game_state {
   bool is_single_step = false;
   bool do_reset_texture = false;
   bool do_save_texture = false;
+  bool do_archive = false;
+  bool do_record_rows = false;
+  bool do_dump_profile = false;
   bool do_update_rule = false;
+  bool do_update_boundary = false;
+  bool do_reset = false;
   int gen_count = 0;
   int wolfram_code = 0;
+  qca::boundary boundary = qca::boundary::zero;
+  qca::init_mode init = qca::init_mode::random;
 };
 
-using key_f = std::function<void(qca::elementary &ca, game_state &s)>;
+using key_f = std::function<void(game_state &s)>;
 
 struct key {
   const int key_code;
   const std::string_view name;
-  const key_f f = [](qca::elementary &ca, game_state &s){};
+  const key_f f = [](game_state &s){};
   bool is_pressed = false;
   bool is_handled = false;
 };
 
 static key key_pause{
   GLFW_KEY_SPACE, "SPACEBAR",
-  [](qca::elementary &ca, game_state &s){
+  [](game_state &s){
     s.is_paused = !s.is_paused;
   }
 };
 static key key_step{
   GLFW_KEY_PERIOD, ">",
-  [](qca::elementary &ca, game_state &s){
+  [](game_state &s){
     s.is_paused = false;
     s.is_single_step = true;
   }
 };
 static key key_reset_single_1{
   GLFW_KEY_1, "1",
-  [](qca::elementary &ca, game_state &s){
-    ca.reset();
-    ca.init_single_1();
+  [](game_state &s){
+    s.init = qca::init_mode::single_1;
+    s.do_reset = true;
     s.gen_count = 0;
     s.is_paused = false;
     s.do_reset_texture = true;
@@ -50,9 +57,9 @@ static key key_reset_single_1{
 };
 static key key_reset_random{
   GLFW_KEY_R, "R",
-  [](qca::elementary &ca, game_state &s){
-    ca.reset();
-    ca.init_random();
+  [](game_state &s){
+    s.init = qca::init_mode::random;
+    s.do_reset = true;
     s.gen_count = 0;
     s.is_paused = false;
     s.do_reset_texture = true;
@@ -60,9 +67,9 @@ static key key_reset_random{
 };
 static key key_reset_alternate{
   GLFW_KEY_APOSTROPHE, "@",
-  [](qca::elementary &ca, game_state &s){
-    ca.reset();
-    ca.init_alternate();
+  [](game_state &s){
+    s.init = qca::init_mode::alternate;
+    s.do_reset = true;
     s.gen_count = 0;
     s.is_paused = false;
     s.do_reset_texture = true;
@@ -70,13 +77,31 @@ static key key_reset_alternate{
 };
 static key key_save{
   GLFW_KEY_S, "S",
-  [](qca::elementary &ca, game_state &s){
+  [](game_state &s){
     s.do_save_texture = true;
   }
 };
+static key key_archive{
+  GLFW_KEY_A, "A",
+  [](game_state &s){
+    s.do_archive = true;
+  }
+};
+static key key_rows{
+  GLFW_KEY_M, "M",
+  [](game_state &s){
+    s.do_record_rows = true;
+  }
+};
+static key key_profile{
+  GLFW_KEY_P, "P",
+  [](game_state &s){
+    s.do_dump_profile = true;
+  }
+};
 static key key_next{
   GLFW_KEY_RIGHT_BRACKET , "]",
-  [](qca::elementary &ca, game_state &s){
+  [](game_state &s){
     s.wolfram_code++;
     if (s.wolfram_code > 255) { s.wolfram_code = 0; }
     s.do_update_rule = true;
@@ -84,13 +109,26 @@ static key key_next{
 };
 static key key_prev{
   GLFW_KEY_LEFT_BRACKET , "[",
-  [](qca::elementary &ca, game_state &s){
+  [](game_state &s){
     s.wolfram_code--;
     if (s.wolfram_code < 0) { s.wolfram_code = 255; }
     s.do_update_rule = true;
   }
 };
 
+static key key_boundary{
+  GLFW_KEY_B, "B",
+  [](game_state &s){
+    switch (s.boundary) {
+      case qca::boundary::zero: s.boundary = qca::boundary::one; break;
+      case qca::boundary::one: s.boundary = qca::boundary::periodic; break;
+      case qca::boundary::periodic: s.boundary = qca::boundary::reflect; break;
+      case qca::boundary::reflect: s.boundary = qca::boundary::zero; break;
+    }
+    s.do_update_boundary = true;
+  }
+};
+
 static std::vector<key> key_bindings = {
   key_pause,
   key_step,
@@ -98,8 +136,12 @@ static std::vector<key> key_bindings = {
   key_reset_alternate,
   key_reset_random,
   key_save,
+  key_archive,
+  key_rows,
+  key_profile,
   key_next,
-  key_prev
+  key_prev,
+  key_boundary
 };
 
 #endif // __KEY_BINDINGS_HPP__
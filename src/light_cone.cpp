@@ -0,0 +1,131 @@
+#include <algorithm>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+#include "kernels.hpp"
+#include "light_cone.hpp"
+
+static constexpr uint64_t tail_mask(const int width) {
+  return (width % 64 == 0) ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1;
+}
+
+// the cone is cut out of the row as a window of its own. a side of the window
+// that reaches the edge of the field keeps the boundary and does not shrink,
+// any other side shrinks by a cell per step and is left stale behind it.
+// visit is given cell x of each of the n generations in turn, nothing else
+// is kept.
+template <typename Boundary, typename F>
+static void evolve_cone(
+  const qca::packed_generation &p, const uint8_t code, const int x,
+  const uint64_t n, const F &visit
+) {
+  const int width = p.width;
+  const bool wrap = (Boundary::type == qca::boundary::periodic);
+  const int64_t reach = std::min<uint64_t>(n - 1, width);
+
+  int64_t lo = x - reach;
+  int64_t hi = x + reach + 1;
+  bool clip_left = false;
+  bool clip_right = false;
+
+  if (wrap && hi - lo >= width) {
+    lo = 0;
+    hi = width;
+    clip_left = true;
+    clip_right = true;
+  } else if (!wrap) {
+    clip_left = (lo <= 0);
+    clip_right = (hi >= width);
+    lo = std::max<int64_t>(lo, 0);
+    hi = std::min<int64_t>(hi, width);
+  }
+
+  const int len = hi - lo;
+  const std::size_t words = (len + 63) / 64;
+  std::vector<uint64_t> front(words + 2, 0);
+  std::vector<uint64_t> back(words + 2, 0);
+
+  for (int i = 0; i < len; ++i) {
+    const int64_t c = ((lo + i) % width + width) % width;
+    if (qca::boundaries::cell(p.words.data(), c)) {
+      front[1 + i / 64] |= uint64_t{1} << (i % 64);
+    }
+  }
+
+  const qca::step_kernel kernel = qca::active_kernel();
+  const int at = x - lo;
+
+  for (uint64_t s = 0; ; ++s) {
+    visit(qca::boundaries::cell(front.data() + 1, at));
+    if (s + 1 == n) { break; }
+
+    // cells still inside the cone after this step
+    const int64_t a = clip_left ? 0 : s + 1;
+    const int64_t b = clip_right ? len : len - s - 1;
+    const std::size_t begin = a / 64;
+    const std::size_t end = (b - 1) / 64 + 1;
+
+    qca::boundaries::fill<Boundary>(front.data() + 1, len);
+    kernel(front.data() + 1, back.data() + 1, begin, end, code);
+
+    if (end == words) {
+      back[words] &= tail_mask(len);
+    }
+
+    std::swap(front, back);
+  }
+}
+
+template <typename F>
+static void evolve(
+  const qca::packed_generation &p, const uint8_t code, const qca::boundary b,
+  const int x, const uint64_t n, const F &visit
+) {
+  namespace boundaries = qca::boundaries;
+
+  switch (b) {
+    case qca::boundary::one:
+      evolve_cone<boundaries::one>(p, code, x, n, visit);
+      break;
+    case qca::boundary::periodic:
+      evolve_cone<boundaries::periodic>(p, code, x, n, visit);
+      break;
+    case qca::boundary::reflect:
+      evolve_cone<boundaries::reflect>(p, code, x, n, visit);
+      break;
+    default:
+      evolve_cone<boundaries::zero>(p, code, x, n, visit);
+      break;
+  }
+}
+
+uint8_t qca::cell_at(
+  const packed_generation &p, const uint8_t code, const boundary b,
+  const int x, const uint64_t t
+) {
+  if (x < 0 || x >= p.width) {
+    return 0;
+  }
+
+  // only the last cell is wanted, the ones on the way are dropped
+  uint8_t cell = 0;
+  evolve(p, code, b, x, t + 1, [&](const uint8_t c) { cell = c; });
+  return cell;
+}
+
+std::vector<uint8_t> qca::column(
+  const packed_generation &p, const uint8_t code, const boundary b,
+  const int x, const uint64_t n
+) {
+  if (n == 0 || x < 0 || x >= p.width) {
+    return {};
+  }
+
+  std::vector<uint8_t> out;
+  out.reserve(n);
+  evolve(p, code, b, x, n, [&](const uint8_t c) { out.push_back(c); });
+  return out;
+}
@@ -0,0 +1,28 @@
+#ifndef __LIGHT_CONE_HPP__
+#define __LIGHT_CONE_HPP__
+#include <cstdint>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+namespace qca {
+  // cell x of the generation t steps after p.
+  // only the backward light cone of (x, t) is evolved, the cells within t of
+  // x shrinking by one either side per step, so the cost is independent of
+  // the width of the row.
+  uint8_t cell_at(
+    const packed_generation &p, const uint8_t code, const boundary b,
+    const int x, const uint64_t t
+  );
+
+  // cell x of the n generations starting with p.
+  // the light cone of (x, n - 1) contains (x, t) for every earlier t, so the
+  // whole column comes out of evolving that one shrinking triangle.
+  std::vector<uint8_t> column(
+    const packed_generation &p, const uint8_t code, const boundary b,
+    const int x, const uint64_t n
+  );
+}
+
+#endif // __LIGHT_CONE_HPP__
@@ -0,0 +1,372 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <optional>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+#include "linear.hpp"
+
+// widest row the matrix fallback takes on, its matrix is width^2 / 8 bytes
+static constexpr int max_matrix_width = 4096;
+
+static constexpr std::size_t words_for(const uint64_t width) {
+  return (width + 63) / 64;
+}
+
+static constexpr uint64_t tail_mask(const uint64_t width) {
+  return (width % 64 == 0) ? ~uint64_t{0} : (uint64_t{1} << (width % 64)) - 1;
+}
+
+static bool get_bit(const std::vector<uint64_t> &w, const uint64_t i) {
+  return (w[i / 64] >> (i % 64)) & 1;
+}
+
+static void flip_bit(std::vector<uint64_t> &w, const uint64_t i) {
+  w[i / 64] ^= uint64_t{1} << (i % 64);
+}
+
+// out[i] = in[i - k], zero where i - k falls off the start
+static void shift_up(
+  const std::vector<uint64_t> &in, std::vector<uint64_t> &out,
+  const uint64_t width, const uint64_t k
+) {
+  const std::size_t n = in.size();
+  const uint64_t q = k / 64;
+  const int r = k % 64;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    uint64_t v = 0;
+    if (i >= q) {
+      v = in[i - q] << r;
+      if (r != 0 && i >= q + 1) {
+        v |= in[i - q - 1] >> (64 - r);
+      }
+    }
+    out[i] = v;
+  }
+
+  if (n > 0) {
+    out[n - 1] &= tail_mask(width);
+  }
+}
+
+// out[i] = in[i + k], zero where i + k falls off the end. bits past the
+// width are zero in, so they shift in as zero.
+static void shift_down(
+  const std::vector<uint64_t> &in, std::vector<uint64_t> &out,
+  const uint64_t k
+) {
+  const std::size_t n = in.size();
+  const uint64_t q = k / 64;
+  const int r = k % 64;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    uint64_t v = 0;
+    if (i + q < n) {
+      v = in[i + q] >> r;
+      if (r != 0 && i + q + 1 < n) {
+        v |= in[i + q + 1] << (64 - r);
+      }
+    }
+    out[i] = v;
+  }
+}
+
+// one factor of the power: x = (L^s x & l) ^ (x & c) ^ (R^s x & r), where L^s
+// takes each cell from s to its left and R^s from s to its right. on a ring
+// they wrap round, otherwise cells come in as zero.
+static void apply(
+  std::vector<uint64_t> &x, const qca::affine_rule &f, const uint64_t width,
+  const uint64_t s, const bool ring, std::vector<uint64_t> &up,
+  std::vector<uint64_t> &down, std::vector<uint64_t> &scratch
+) {
+  if (f.left) {
+    shift_up(x, up, width, s);
+    if (ring && s != 0) {
+      shift_down(x, scratch, width - s);
+      for (std::size_t i = 0; i < x.size(); ++i) { up[i] |= scratch[i]; }
+    }
+  }
+  if (f.right) {
+    shift_down(x, down, s);
+    if (ring && s != 0) {
+      shift_up(x, scratch, width, width - s);
+      for (std::size_t i = 0; i < x.size(); ++i) { down[i] |= scratch[i]; }
+    }
+  }
+
+  for (std::size_t i = 0; i < x.size(); ++i) {
+    uint64_t v = f.centre ? x[i] : 0;
+    if (f.left) { v ^= up[i]; }
+    if (f.right) { v ^= down[i]; }
+    x[i] = v;
+  }
+}
+
+// the linear part of n steps, one factor per set bit of n. every factor is
+// a polynomial in the same shift, so they can go in any order.
+static void power(
+  std::vector<uint64_t> &x, const qca::affine_rule &f, const uint64_t width,
+  const uint64_t n, const bool ring
+) {
+  std::vector<uint64_t> up(x.size());
+  std::vector<uint64_t> down(x.size());
+  std::vector<uint64_t> scratch(x.size());
+
+  // 2^k cells, taken mod the width on a ring and capped at it otherwise
+  uint64_t s = ring ? 1 % width : 1;
+  for (uint64_t bits = n; bits != 0; bits >>= 1) {
+    if (bits & 1) {
+      apply(x, f, width, s, ring, up, down, scratch);
+    }
+    s = ring ? (2 * s) % width : std::min(2 * s, width);
+  }
+}
+
+static void complement(std::vector<uint64_t> &x, const uint64_t width) {
+  for (uint64_t &w : x) { w = ~w; }
+  if (!x.empty()) {
+    x.back() &= tail_mask(width);
+  }
+}
+
+// n steps round a ring. the constant adds the all ones row each step, and
+// the step takes that to itself or to zero as the rule has an odd or even
+// number of terms, so it either toggles or is there from the first step on.
+static void ring_jump(
+  std::vector<uint64_t> &x, const qca::affine_rule &f, const uint64_t width,
+  const uint64_t n
+) {
+  power(x, f, width, n, true);
+
+  const bool odd = f.left ^ f.centre ^ f.right;
+  if (f.constant && (odd ? n % 2 == 1 : n > 0)) {
+    complement(x, width);
+  }
+}
+
+// the row, then edge cells and its mirror image as one ring. a symmetric
+// rule keeps the ring symmetric, so its first width cells carry on as the
+// row would between reflecting or constant edges.
+static std::vector<uint64_t> mirror(
+  const qca::packed_generation &p, const std::optional<bool> edge,
+  uint64_t &length
+) {
+  const uint64_t width = p.width;
+  length = edge ? 2 * width + 2 : 2 * width;
+  std::vector<uint64_t> ring(words_for(length), 0);
+
+  std::copy(p.words.begin(), p.words.end(), ring.begin());
+  const uint64_t back = edge ? width + 1 : width;
+  for (uint64_t i = 0; i < width; ++i) {
+    if (get_bit(p.words, i)) {
+      flip_bit(ring, back + width - 1 - i);
+    }
+  }
+  if (edge && *edge) {
+    flip_bit(ring, width);
+    flip_bit(ring, 2 * width + 1);
+  }
+
+  return ring;
+}
+
+// the step as a (width + 1)^2 matrix over GF(2), the extra row and column
+// carrying the constant and the edges so an affine step is a product
+static std::vector<uint64_t> step_matrix(
+  const qca::affine_rule &f, const qca::boundary b, const uint64_t width,
+  const std::size_t row_words
+) {
+  std::vector<uint64_t> m((width + 1) * row_words, 0);
+  const auto toggle = [&](const uint64_t i, const uint64_t j) {
+    m[i * row_words + j / 64] ^= uint64_t{1} << (j % 64);
+  };
+  const uint64_t one = width;
+
+  // where a neighbour off the edge comes from, `one` for a constant 1
+  const auto outside = [&](const bool left) -> std::optional<uint64_t> {
+    switch (b) {
+      case qca::boundary::one: return one;
+      case qca::boundary::periodic: return left ? width - 1 : 0;
+      case qca::boundary::reflect: return left ? 0 : width - 1;
+      default: return std::nullopt;
+    }
+  };
+
+  for (uint64_t i = 0; i < width; ++i) {
+    if (f.centre) { toggle(i, i); }
+    if (f.constant) { toggle(i, one); }
+
+    if (f.left) {
+      const auto j = (i > 0) ? std::optional<uint64_t>(i - 1) : outside(true);
+      if (j) { toggle(i, *j); }
+    }
+    if (f.right) {
+      const auto j = (i + 1 < width)
+        ? std::optional<uint64_t>(i + 1) : outside(false);
+      if (j) { toggle(i, *j); }
+    }
+  }
+  toggle(one, one);
+
+  return m;
+}
+
+static void multiply_vector(
+  const std::vector<uint64_t> &m, std::vector<uint64_t> &x,
+  const uint64_t rows, const std::size_t row_words
+) {
+  std::vector<uint64_t> y(row_words, 0);
+  for (uint64_t i = 0; i < rows; ++i) {
+    uint64_t parity = 0;
+    for (std::size_t k = 0; k < row_words; ++k) {
+      parity ^= m[i * row_words + k] & x[k];
+    }
+    if (__builtin_popcountll(parity) & 1) {
+      flip_bit(y, i);
+    }
+  }
+
+  x = std::move(y);
+}
+
+// row i of m^2 is the sum of the rows of m picked out by row i of m
+static void square(
+  std::vector<uint64_t> &m, const uint64_t rows, const std::size_t row_words
+) {
+  std::vector<uint64_t> out(m.size(), 0);
+  for (uint64_t i = 0; i < rows; ++i) {
+    uint64_t *to = out.data() + i * row_words;
+    for (uint64_t j = 0; j < rows; ++j) {
+      if ((m[i * row_words + j / 64] >> (j % 64)) & 1) {
+        const uint64_t *from = m.data() + j * row_words;
+        for (std::size_t k = 0; k < row_words; ++k) { to[k] ^= from[k]; }
+      }
+    }
+  }
+
+  m = std::move(out);
+}
+
+// squaring costs about rows^2 / 2 row additions per bit of n, stepping a
+// row per step, so the matrix only pays for far more steps than cells
+static bool matrix_pays(const uint64_t width, const uint64_t n) {
+  if (width > max_matrix_width) { return false; }
+
+  const uint64_t rows = width + 1;
+  const uint64_t bits = 64 - __builtin_clzll(n);
+  return rows * rows / 2 * bits < n;
+}
+
+static std::vector<uint64_t> matrix_jump(
+  const qca::packed_generation &p, const qca::affine_rule &f,
+  const qca::boundary b, const uint64_t n
+) {
+  const uint64_t width = p.width;
+  const uint64_t rows = width + 1;
+  const std::size_t row_words = words_for(rows);
+
+  std::vector<uint64_t> m = step_matrix(f, b, width, row_words);
+  std::vector<uint64_t> x(row_words, 0);
+  std::copy(p.words.begin(), p.words.end(), x.begin());
+  flip_bit(x, width);
+
+  for (uint64_t bits = n; bits != 0; bits >>= 1) {
+    if (bits & 1) {
+      multiply_vector(m, x, rows, row_words);
+    }
+    if (bits > 1) {
+      square(m, rows, row_words);
+    }
+  }
+
+  x.resize(words_for(width));
+  if (!x.empty()) {
+    x.back() &= tail_mask(width);
+  }
+  return x;
+}
+
+std::optional<qca::affine_rule> qca::affine(const uint8_t code) {
+  const rule_set r = wolfram(code);
+  affine_rule f;
+  f.constant = r[0];
+  f.right = r[1] ^ f.constant;
+  f.centre = r[2] ^ f.constant;
+  f.left = r[4] ^ f.constant;
+
+  for (int i = 0; i < 8; ++i) {
+    const bool l = i & 4;
+    const bool c = i & 2;
+    const bool rr = i & 1;
+    const bool v = (l & f.left) ^ (c & f.centre) ^ (rr & f.right) ^ f.constant;
+    if (v != bool(r[i])) { return std::nullopt; }
+  }
+
+  return f;
+}
+
+std::optional<qca::packed_generation> qca::jump(
+  const packed_generation &p, const uint8_t code, const boundary b,
+  const uint64_t n
+) {
+  const std::optional<affine_rule> f = affine(code);
+  if (!f || p.width <= 0) { return std::nullopt; }
+  if (n == 0) { return p; }
+
+  const uint64_t width = p.width;
+  packed_generation out{p.width, p.words};
+
+  // a rule that ignores its neighbours ignores the edges too
+  if (b == boundary::periodic || (!f->left && !f->right)) {
+    ring_jump(out.words, *f, width, n);
+    return out;
+  }
+
+  const bool fixed = (b == boundary::zero || b == boundary::one);
+  const bool edge = (b == boundary::one);
+
+  // a one sided rule only sees one edge, and if the row of all edge cells
+  // is a fixed point the cells past it stay put. taking that row away
+  // leaves the linear part alone on a line where the edge is zero.
+  if (fixed && (!f->left || !f->right)) {
+    const bool odd = f->left ^ f->centre ^ f->right;
+    if (((odd && edge) ^ f->constant) == edge) {
+      if (edge) { complement(out.words, width); }
+      power(out.words, *f, width, n, false);
+      if (edge) { complement(out.words, width); }
+      return out;
+    }
+  }
+
+  // both sides, so symmetric. reflecting edges always mirror, constant
+  // ones as long as the step leaves an edge cell between mirrored
+  // neighbours as it was.
+  if (f->left && f->right) {
+    const bool holds = (b == boundary::reflect) ||
+      (fixed && ((f->centre && edge) ^ f->constant) == edge);
+    if (holds) {
+      uint64_t length = 0;
+      std::vector<uint64_t> ring = mirror(
+        p, fixed ? std::optional<bool>(edge) : std::nullopt, length
+      );
+      ring_jump(ring, *f, length, n);
+
+      std::copy_n(ring.begin(), out.words.size(), out.words.begin());
+      if (!out.words.empty()) {
+        out.words.back() &= tail_mask(width);
+      }
+      return out;
+    }
+  }
+
+  if (matrix_pays(width, n)) {
+    out.words = matrix_jump(p, *f, b, n);
+    return out;
+  }
+
+  return std::nullopt;
+}
@@ -0,0 +1,40 @@
+#ifndef __LINEAR_HPP__
+#define __LINEAR_HPP__
+#include <cstdint>
+#include <optional>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+namespace qca {
+  // an elementary rule that is affine over GF(2): the next state of a cell
+  // is (left & l) ^ (centre & c) ^ (right & r) ^ constant. these are 60, 90,
+  // 102, 150, 170, 204, 240, the constant rules 0 and 255, and the
+  // complement of each.
+  struct affine_rule {
+    bool left = false;
+    bool centre = false;
+    bool right = false;
+    bool constant = false;
+  };
+
+  std::optional<affine_rule> affine(const uint8_t code);
+
+  // the generation n steps after p, for affine rules only.
+  //
+  // a step is a polynomial in the shift, and squaring over GF(2) only
+  // spreads its terms, so the 2^k th power of the step is the same three
+  // terms 2^k cells apart. n steps then cost one pass over the row per bit
+  // of n. this holds for periodic rows and for one sided rules whose edge
+  // stays constant, and the symmetric rules reach it by mirroring the row
+  // into a ring twice as long. anything else is the step as a matrix,
+  // raised to n by squaring, but only where that beats stepping.
+  //
+  // empty if the rule is not affine or stepping is as quick.
+  std::optional<packed_generation> jump(
+    const packed_generation &p, const uint8_t code, const boundary b,
+    const uint64_t n
+  );
+}
+
+#endif // __LINEAR_HPP__
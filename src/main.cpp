@@ -6,12 +6,13 @@
 #include <iostream>
 #include <limits>
 #include <map>
+#include <optional>
+#include <random>
 #include <regex>
 #include <sstream>
 #include <string>
+#include <string_view>
 
-#define STB_IMAGE_WRITE_IMPLEMENTATION
-#include "stb_image_write.h"
 #include "glad.h"
 #include <GLFW/glfw3.h>
 
@@ -22,20 +23,32 @@
 #include <qxdg/qxdg.hpp>
 #include <qfio/qfio.hpp>
 
+#include "archive.hpp"
+#include "checkpoint.hpp"
 #include "elementary.hpp"
+#include "general.hpp"
+#include "history.hpp"
+#include "kernels.hpp"
 #include "keys.hpp"
+#include "mapped_rows.hpp"
 
 #include "gl/rect.hpp"
 #include "gl/shader_program.hpp"
 #include "gl/texture.hpp"
 #include "gl/window.hpp"
 #include "util/error.hpp"
+#include "util/png_writer.hpp"
+#include "util/profiler.hpp"
 #include "util/timer.hpp"
+#include "util/trace.hpp"
 
 static constexpr int window_width = 800;
 static constexpr int window_height = 200;
 static constexpr int gl_major_version = 3;
 static constexpr int gl_minor_version = 3;
+static constexpr std::size_t history_cap = 1 << 20;
+static constexpr uint64_t checkpoint_interval = 64;
+static constexpr std::string_view checkpoint_path = "out/checkpoint.qcp";
 
 
 constexpr timing::seconds loop_timestep(1.0/60.0);
@@ -45,8 +58,38 @@ std::array<glm::mat4, 3> fullscreen_rect_matrices(const int w, const int h);
 void reset_texture(
   const Texture &t, const int w, const int h, const std::vector<uint8_t> &d
 );
+std::vector<uint8_t> read_texture(const Texture &t, const int w, const int h);
 
 int main(int argc, const char *argv[]) {
+  // QCA_TRACE=file records a timeline of the run into file, see trace.hpp
+  tracing::Session trace;
+  tracing::name_thread("main");
+
+  // elementary runs are checkpointed as they go, and --resume carries on
+  // from the last one
+  std::optional<qca::elementary_state> resume;
+  if (argc == 3 && std::string_view(argv[1]) == "--resume") {
+    resume = qca::read_checkpoint(argv[2]);
+    if (!resume) {
+      std::cerr << "invalid checkpoint: " << argv[2] << "\n";
+      return to_underlying(error_code_t::invalid_arg);
+    }
+    argc = 1;
+  }
+
+  if (argc > 2) {
+    std::cerr << "usage: " << argv[0] << " [rule spec]\n"
+      << "       " << argv[0] << " --resume checkpoint\n";
+    return to_underlying(error_code_t::too_many_args);
+  }
+
+  const std::string_view rule_spec = (argc == 2) ? argv[1] : "73";
+  const std::optional<qca::rule_table> rule = qca::parse_rule(rule_spec);
+  if (!rule) {
+    std::cerr << "invalid rule spec: " << rule_spec << "\n";
+    return to_underlying(error_code_t::invalid_rule);
+  }
+
   // get base directories
   xdg::base base_dirs = xdg::get_base_directories();
 
@@ -86,9 +129,100 @@ int main(int argc, const char *argv[]) {
   GLuint f_shader = createShader(GL_FRAGMENT_SHADER, *f_shader_string);
   GLuint shader_program = createProgram(v_shader, f_shader, true);
 
-  // initialise automata
-  qca::elementary ca(window_width, window_height, qca::wolfram(73));
-  ca.init_random();
+  game_state state;
+
+  // initialise automata. elementary rules run on the bit-packed engine, wider
+  // or multi-state rules on the general one, the viewer drives whichever is
+  // in use through ca_init/ca_palette/ca_next
+  if (qca::is_elementary(*rule)) {
+    state.wolfram_code = qca::elementary_code(*rule);
+  }
+
+  qca::elementary ca(
+    window_width, window_height, qca::wolfram(state.wolfram_code),
+    state.boundary
+  );
+  ca.set_cycle_detection(true);
+  bool cycle_reported = false;
+
+  std::optional<qca::general> general_ca;
+  if (!qca::is_elementary(*rule)) {
+    general_ca.emplace(window_width, window_height, *rule, state.boundary);
+  }
+
+  // elementary rows are kept packed for saving, the rule and boundary only
+  // change on a reset so the history is started over with them. each run
+  // gets a seed of its own so an archive of it can be run again.
+  qca::history_store history;
+  qca::archive_info run;
+  std::random_device seeds;
+
+  const auto ca_init = [&](const qca::init_mode m) {
+    run = {
+      ca.field_width, static_cast<uint8_t>(state.wolfram_code),
+      state.boundary, m, seeds()
+    };
+    ca.seed(run.seed);
+
+    if (general_ca) { general_ca->init(m); } else { ca.init(m); }
+    history = qca::history_store(
+      run.width, run.code, run.edges, history_cap
+    );
+  };
+  const auto ca_palette = [&]() -> const qca::palette & {
+    return general_ca ? general_ca->get_palette() : ca.get_palette();
+  };
+  const auto ca_next = [&]() {
+    if (general_ca) { general_ca->next(); } else { ca.next(); }
+  };
+
+  if (resume) {
+    // the run goes on from the checkpoint as it was, so nothing is seeded
+    // or initialised and the run is described by what it started from
+    if (
+      resume->width != ca.field_width || resume->height != ca.field_height ||
+      !ca.set_state(*resume)
+    ) {
+      std::cerr << "checkpoint is for a " << resume->width << "x"
+        << resume->height << " field\n";
+      return to_underlying(error_code_t::invalid_arg);
+    }
+
+    state.wolfram_code = qca::rule_code(resume->working_rules);
+    state.boundary = resume->working_edges;
+    state.init = resume->init;
+    run = {
+      ca.field_width, static_cast<uint8_t>(state.wolfram_code),
+      state.boundary, state.init, resume->seed
+    };
+    history = qca::history_store(
+      run.width, run.code, run.edges, history_cap
+    );
+
+    // the rows before the checkpoint are stepped again from the first one,
+    // which the cycle search keeps, so the history and the picture line up
+    // with the engine. without it they start at the checkpoint.
+    qca::elementary replay = ca;
+    if (replay.advance_to(0)) {
+      for (uint64_t n = 0; n < resume->generation; ++n) {
+        history.push(replay.get_packed());
+        replay.next();
+      }
+    }
+    state.gen_count = std::min<uint64_t>(history.size(), ca.field_height);
+
+    std::cout << "Resumed rule " << state.wolfram_code << " at generation "
+      << ca.generation_count() << "\n";
+  } else {
+    ca_init(state.init);
+    std::cout << "Rule: " << rule_spec << "\n";
+  }
+
+  qca::checkpoint_writer checkpoints(
+    std::string(checkpoint_path), checkpoint_interval
+  );
+
+  std::cout << "Kernel: " << qca::isa_name(qca::active_isa()) << "\n";
 
   // initialise texture
   static const std::size_t num_cols = ca.field_width;
@@ -125,56 +259,230 @@ int main(int argc, const char *argv[]) {
   std::vector<uint8_t> blank_texture;
   blank_texture.resize(ca.field_width * ca.field_height * 3);
 
-  std::vector<uint8_t> full_texture_data;
-  full_texture_data.resize(ca.field_width * ca.field_height * 3);
+  std::vector<uint8_t> texture_data(ca.field_width * 3);
 
-  game_state state;
+  // a resumed run draws the rows it replayed
+  for (int n = 0; n < state.gen_count; ++n) {
+    qca::cells_to_colour(history.at(n), ca.get_palette(), texture_data.data());
+    bindTexture(texture);
+    glTexSubImage2D(
+      GL_TEXTURE_2D, 0, 0, n, ca.field_width, 1,
+      GL_RGB, GL_UNSIGNED_BYTE, texture_data.data()
+    );
+    bindTexture({0});
+  }
+
+  // a save writes out the rows drawn so far, then each new row as it is
+  // drawn, and finishes the file once the field is full or the run is reset
+  std::optional<png::Writer> recording;
+  std::string recording_path;
+
+  const auto finish_recording = [&]() {
+    if (!recording) { return; }
+    const bool empty = recording->rows() == 0;
+    if (recording->finish()) {
+      std::cout << "Saved: " << recording_path << "\n";
+    } else if (empty) {
+      std::cerr << "Nothing drawn to save in " << recording_path << "\n";
+    } else {
+      std::cerr << "Failed to save " << recording_path << "\n";
+    }
+    recording.reset();
+  };
+
+  // an archive of the run is recorded the same way, from the history and
+  // then row by row
+  std::optional<qca::archive_writer> archive;
+  std::string archive_path;
+
+  const auto finish_archive = [&]() {
+    if (!archive) { return; }
+    if (archive->finish()) {
+      std::cout << "Archived: " << archive_path << "\n";
+    } else {
+      std::cerr << "Failed to archive " << archive_path << "\n";
+    }
+    archive.reset();
+  };
+
+  // the bare packed rows can be kept too, in a file other processes can
+  // follow while the run is written, see mapped_rows.hpp
+  std::optional<qca::mapped_row_writer> row_file;
+  std::string row_file_path;
+
+  const auto finish_row_file = [&]() {
+    if (!row_file) { return; }
+    row_file->close();
+    if (row_file->good()) {
+      std::cout << "Rows: " << row_file_path << "\n";
+    } else {
+      std::cerr << "Failed to write rows to " << row_file_path << "\n";
+    }
+    row_file.reset();
+  };
+
+  // where the frame time goes, printed on 'P' and on exit
+  timing::Profiler profiler;
+  const std::size_t phase_frame = profiler.phase("frame");
+  const std::size_t phase_input = profiler.phase("input");
+  const std::size_t phase_step = profiler.phase("step");
+  const std::size_t phase_colour = profiler.phase("colour");
+  const std::size_t phase_upload = profiler.phase("upload");
+  const std::size_t phase_draw = profiler.phase("draw");
+  const std::size_t phase_swap = profiler.phase("swap");
 
   while (!glfwWindowShouldClose(window)) {
+    timing::Scope frame(profiler, phase_frame);
+
     loop_accumulator += loop_timer.getDelta();
     loop_timer.tick(clock.get());
 
-    //process input
-    glfwPollEvents();
-    processInput(window);
-
-    // handle user input
-    for (key &k : key_bindings) {
-      if (
-        (glfwGetKey(window, k.key_code) == GLFW_PRESS) &&
-        !k.is_handled
-      ) {
-        k.f(ca, state);
-        k.is_pressed = true;
-        k.is_handled = true;
-      } else if (glfwGetKey(window, k.key_code) == GLFW_RELEASE) {
-        k.is_pressed = false;
-        k.is_handled = false;
+    {
+      timing::Scope input(profiler, phase_input);
+
+      //process input
+      glfwPollEvents();
+      processInput(window);
+
+      // handle user input
+      for (key &k : key_bindings) {
+        if (
+          (glfwGetKey(window, k.key_code) == GLFW_PRESS) &&
+          !k.is_handled
+        ) {
+          k.f(state);
+          k.is_pressed = true;
+          k.is_handled = true;
+        } else if (glfwGetKey(window, k.key_code) == GLFW_RELEASE) {
+          k.is_pressed = false;
+          k.is_handled = false;
+        }
       }
     }
 
+    if (state.do_dump_profile) {
+      profiler.dump(std::cout);
+      state.do_dump_profile = false;
+    }
+
     if (state.do_save_texture) {
+      tracing::Span span("save");
+      finish_recording();
+
       std::stringstream ss;
       ss << "out/" << state.wolfram_code << ".png";
-      stbi_write_png(
-        ss.str().c_str(), ca.field_width, ca.field_height, 3,
-        full_texture_data.data(), ca.field_width * 3
-      );
+      recording_path = ss.str();
+      recording.emplace(recording_path, ca.field_width);
+
+      // elementary rows come back from the history, the general engine's
+      // only copy of the picture is the texture itself
+      const int drawn = state.gen_count;
+      if (general_ca) {
+        const std::vector<uint8_t> image =
+          read_texture(texture, ca.field_width, ca.field_height);
+        for (int n = 0; n < drawn; ++n) {
+          recording->write_row(image.data() + n * ca.field_width * 3);
+        }
+      } else {
+        for (int n = 0; n < drawn && uint64_t(n) < history.size(); ++n) {
+          qca::cells_to_colour(
+            history.at(n), ca.get_palette(), texture_data.data()
+          );
+          recording->write_row(texture_data.data());
+        }
+      }
+
+      if (state.gen_count >= ca.field_height) {
+        finish_recording();
+      }
       state.do_save_texture = false;
     }
 
-    if (state.do_reset_texture) {
-      reset_texture(texture, ca.field_width, ca.field_height, blank_texture);
-      state.do_reset_texture = false;
+    if (state.do_archive) {
+      tracing::Span span("archive");
+      finish_archive();
+
+      if (general_ca) {
+        std::cerr << "Only elementary runs can be archived\n";
+      } else {
+        std::stringstream ss;
+        ss << "out/" << int(run.code) << ".qca";
+        archive_path = ss.str();
+        archive.emplace(archive_path, run);
+
+        for (uint64_t n = 0; n < history.size(); ++n) {
+          archive->push(history.at(n));
+        }
+        if (state.gen_count >= ca.field_height) {
+          finish_archive();
+        }
+      }
+      state.do_archive = false;
+    }
+
+    if (state.do_record_rows) {
+      tracing::Span span("rows");
+      finish_row_file();
+
+      if (general_ca) {
+        std::cerr << "Only elementary runs can be written as rows\n";
+      } else {
+        std::stringstream ss;
+        ss << "out/" << int(run.code) << ".qcr";
+        row_file_path = ss.str();
+        row_file.emplace(row_file_path, run.width);
+
+        for (uint64_t n = 0; n < history.size(); ++n) {
+          row_file->push(history.at(n));
+        }
+        row_file->flush();
+        if (state.gen_count >= ca.field_height) {
+          finish_row_file();
+        }
+      }
+      state.do_record_rows = false;
     }
 
     if (state.do_update_rule) {
+      // stepping through wolfram codes goes back to the elementary engine.
+      // it has not been running, so it starts a new run as a reset would.
+      if (general_ca) {
+        general_ca.reset();
+        state.do_reset = true;
+        state.do_reset_texture = true;
+        state.gen_count = 0;
+        state.is_paused = false;
+      }
       ca.set_rules(qca::wolfram(state.wolfram_code));
       std::cout << "Wolfram Code: " << state.wolfram_code << "\n";
       state.do_update_rule = false;
     }
 
-    // update loop
+    if (state.do_update_boundary) {
+      ca.set_boundary(state.boundary);
+      if (general_ca) { general_ca->set_boundary(state.boundary); }
+      std::cout << "Boundary: " << qca::boundary_name(state.boundary) << "\n";
+      state.do_update_boundary = false;
+    }
+
+    if (state.do_reset_texture) {
+      reset_texture(texture, ca.field_width, ca.field_height, blank_texture);
+      state.do_reset_texture = false;
+    }
+
+    // after any rule or boundary change, so the reset picks them up and the
+    // run and history are stamped with what the engine will step
+    if (state.do_reset) {
+      finish_recording();
+      finish_archive();
+      finish_row_file();
+      ca_init(state.init);
+      cycle_reported = false;
+      state.do_reset = false;
+    }
+
+    // update loop, several steps at once when a frame has run long
+    tracing::begin("update");
     while (loop_accumulator >= loop_timestep) {
       if (state.gen_count >= ca.field_height) {
         state.is_paused = true;
@@ -190,35 +498,93 @@ int main(int argc, const char *argv[]) {
         state.is_single_step = false;
       }
 
-      auto gen = ca.get();
-      ca.next();
+      // elementary rows stay packed from the engine to the history, the
+      // archive and the colour lookup
+      qca::generation gen;
+      qca::packed_generation row;
+      {
+        timing::Scope step(profiler, phase_step);
+        tracing::Span span("next");
+        if (general_ca) {
+          gen = general_ca->get();
+        } else {
+          row = ca.get_packed();
+        }
+        ca_next();
+      }
 
-      std::vector<uint8_t> texture_data = qca::cells_to_colour(gen);
-      for (int i = 0; i < texture_data.size(); ++i) {
-        const int index = (state.gen_count * ca.field_width * 3) + i;
-        full_texture_data[index] = texture_data[i];
+      if (!general_ca && !cycle_reported && ca.get_cycle()) {
+        std::cout << "Cycle: transient " << ca.get_cycle()->transient
+          << ", period " << ca.get_cycle()->period << "\n";
+        cycle_reported = true;
       }
 
-      bindTexture(texture);
-      glTexSubImage2D(
-        GL_TEXTURE_2D, 0, 0, state.gen_count, ca.field_width, 1,
-        GL_RGB, GL_UNSIGNED_BYTE, texture_data.data()
-      );
-      bindTexture({0});
+      if (!general_ca) {
+        checkpoints.tick(ca);
+
+        history.push(row);
+        if (archive) {
+          archive->push(row);
+        }
+        if (row_file) {
+          row_file->push(row);
+        }
+      }
+
+      {
+        timing::Scope colour(profiler, phase_colour);
+        if (general_ca) {
+          qca::cells_to_colour(gen, ca_palette(), texture_data.data());
+        } else {
+          qca::cells_to_colour(row, ca_palette(), texture_data.data());
+        }
+      }
+      if (recording) {
+        tracing::Span span("png row");
+        recording->write_row(texture_data.data());
+      }
+
+      {
+        timing::Scope upload(profiler, phase_upload);
+        tracing::Span span("upload");
+        bindTexture(texture);
+        glTexSubImage2D(
+          GL_TEXTURE_2D, 0, 0, state.gen_count, ca.field_width, 1,
+          GL_RGB, GL_UNSIGNED_BYTE, texture_data.data()
+        );
+        bindTexture({0});
+      }
 
       loop_accumulator -= loop_timestep;
       state.gen_count++;
+
+      if (state.gen_count >= ca.field_height) {
+        finish_recording();
+        finish_archive();
+        finish_row_file();
+      }
     }
 
+    tracing::end("update");
+
     // draw screen texture
-    glClear(GL_COLOR_BUFFER_BIT);
+    {
+      timing::Scope draw(profiler, phase_draw);
+      tracing::Span span("draw");
+      glClear(GL_COLOR_BUFFER_BIT);
 
-    glUseProgram(shader_program);
-    bindTexture(texture);
-    drawRect(rect);
-    glfwSwapBuffers(window);
+      glUseProgram(shader_program);
+      bindTexture(texture);
+      drawRect(rect);
+    }
+    {
+      timing::Scope swap(profiler, phase_swap);
+      tracing::Span span("swap");
+      glfwSwapBuffers(window);
+    }
   }
 
+  profiler.dump(std::cout);
   return 0;
 }
 
@@ -250,3 +616,14 @@ void reset_texture(
   );
   bindTexture({0});
 }
+
+std::vector<uint8_t> read_texture(const Texture &t, const int w, const int h) {
+  std::vector<uint8_t> data(w * h * 3);
+
+  bindTexture(t);
+  glPixelStorei(GL_PACK_ALIGNMENT, 1);
+  glGetTexImage(GL_TEXTURE_2D, 0, GL_RGB, GL_UNSIGNED_BYTE, data.data());
+  bindTexture({0});
+
+  return data;
+}
@@ -0,0 +1,247 @@
+#include <algorithm>
+#include <cstddef>
+#include <cstdint>
+#include <cstring>
+#include <string>
+#include <vector>
+
+#include <fcntl.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+
+#include "elementary.hpp"
+#include "mapped_rows.hpp"
+
+static constexpr char magic[8] = {'Q', 'C', 'A', 'R', 'O', 'W', 'S', '\0'};
+static constexpr uint32_t version = 1;
+
+// windows are a multiple of any page size, and the write head drops what is
+// behind it every release_step bytes
+static constexpr std::size_t window_size = std::size_t{64} << 20;
+static constexpr std::size_t release_step = std::size_t{8} << 20;
+// the header's row count is published at least this often, so readers of a
+// narrow run are not left a whole release step behind
+static constexpr uint64_t publish_rows = 4096;
+
+struct header {
+  char magic[8];
+  uint32_t version;
+  uint32_t width;
+  uint64_t rows;
+  uint64_t row_words;
+};
+
+static std::size_t page_floor(const std::size_t n) {
+  static const std::size_t page = sysconf(_SC_PAGESIZE);
+  return n / page * page;
+}
+
+qca::mapped_row_writer::mapped_row_writer(
+  const std::string &path, const int width
+) : field_width(width), row_bytes((width + 63) / 64 * sizeof(uint64_t)) {
+  fd = ::open(path.c_str(), O_RDWR | O_CREAT | O_TRUNC, 0644);
+  if (fd < 0) { return; }
+
+  ok = map_window(0);
+  write_header();
+}
+
+qca::mapped_row_writer::~mapped_row_writer() {
+  close();
+}
+
+bool qca::mapped_row_writer::good() const {
+  return ok;
+}
+
+void qca::mapped_row_writer::push(const packed_generation &g) {
+  if (!ok) { return; }
+
+  write(reinterpret_cast<const uint8_t *>(g.words.data()), row_bytes);
+  // a row cut short by a failed write is not counted, close() trims it off
+  if (!ok) { return; }
+  rows++;
+
+  if (head - submitted >= release_step) {
+    release_behind();
+  } else if (rows % publish_rows == 0) {
+    write_header();
+  }
+}
+
+uint64_t qca::mapped_row_writer::size() const {
+  return rows;
+}
+
+void qca::mapped_row_writer::flush() {
+  write_header();
+}
+
+void qca::mapped_row_writer::close() {
+  if (fd < 0) { return; }
+
+  unmap_window();
+  if (ftruncate(fd, mapped_rows_offset + rows * row_bytes) != 0) {
+    ok = false;
+  }
+  write_header();
+
+  ::close(fd);
+  fd = -1;
+}
+
+void qca::mapped_row_writer::write(const uint8_t *data, std::size_t n) {
+  while (n > 0 && ok) {
+    if (head == window_offset + window_size) {
+      unmap_window();
+      ok = map_window(head);
+      if (!ok) { return; }
+    }
+
+    const std::size_t chunk = std::min(n, window_offset + window_size - head);
+    std::memcpy(window + (head - window_offset), data, chunk);
+    head += chunk;
+    data += chunk;
+    n -= chunk;
+  }
+}
+
+bool qca::mapped_row_writer::map_window(const std::size_t offset) {
+  if (ftruncate(fd, offset + window_size) != 0) { return false; }
+
+  void *p = mmap(
+    nullptr, window_size, PROT_READ | PROT_WRITE, MAP_SHARED, fd, offset
+  );
+  if (p == MAP_FAILED) { return false; }
+
+  window = static_cast<uint8_t *>(p);
+  window_offset = offset;
+  return true;
+}
+
+void qca::mapped_row_writer::unmap_window() {
+  if (window == nullptr) { return; }
+
+  munmap(window, window_size);
+  window = nullptr;
+}
+
+// the newest step is only queued for writeback, the one before it has had a
+// step's worth of time to get there and is waited for and dropped. waiting
+// straight away would stall every step on the disk.
+void qca::mapped_row_writer::release_behind() {
+  const std::size_t end = page_floor(head);
+
+  sync_file_range(fd, submitted, end - submitted, SYNC_FILE_RANGE_WRITE);
+
+  if (submitted > released) {
+    const std::size_t length = submitted - released;
+    sync_file_range(
+      fd, released, length,
+      SYNC_FILE_RANGE_WAIT_BEFORE | SYNC_FILE_RANGE_WRITE |
+      SYNC_FILE_RANGE_WAIT_AFTER
+    );
+
+    const std::size_t from = std::max(released, window_offset);
+    if (from < submitted) {
+      madvise(window + (from - window_offset), submitted - from, MADV_DONTNEED);
+    }
+    posix_fadvise(fd, released, length, POSIX_FADV_DONTNEED);
+  }
+
+  released = submitted;
+  submitted = end;
+
+  write_header();
+}
+
+void qca::mapped_row_writer::write_header() {
+  if (fd < 0) { return; }
+
+  header h{};
+  std::memcpy(h.magic, magic, sizeof(magic));
+  h.version = version;
+  h.width = field_width;
+  h.rows = rows;
+  h.row_words = row_bytes / sizeof(uint64_t);
+
+  if (pwrite(fd, &h, sizeof(h), 0) != sizeof(h)) {
+    ok = false;
+  }
+}
+
+qca::mapped_row_reader::mapped_row_reader(const std::string &path) {
+  fd = ::open(path.c_str(), O_RDONLY);
+  if (fd >= 0) {
+    refresh();
+  }
+}
+
+qca::mapped_row_reader::~mapped_row_reader() {
+  if (map != nullptr) {
+    munmap(const_cast<uint8_t *>(map), map_size);
+  }
+  if (fd >= 0) {
+    ::close(fd);
+  }
+}
+
+bool qca::mapped_row_reader::good() const {
+  return map != nullptr;
+}
+
+uint64_t qca::mapped_row_reader::refresh() {
+  header h{};
+  if (fd < 0 || pread(fd, &h, sizeof(h), 0) != sizeof(h)) { return rows; }
+  if (std::memcmp(h.magic, magic, sizeof(magic)) != 0) { return rows; }
+  if (h.version != version) { return rows; }
+
+  struct stat s{};
+  if (fstat(fd, &s) != 0) { return rows; }
+  const std::size_t file_size = s.st_size;
+
+  if (file_size > map_size) {
+    void *p = mmap(nullptr, file_size, PROT_READ, MAP_SHARED, fd, 0);
+    if (p == MAP_FAILED) { return rows; }
+
+    if (map != nullptr) {
+      munmap(const_cast<uint8_t *>(map), map_size);
+    }
+    map = static_cast<const uint8_t *>(p);
+    map_size = file_size;
+  }
+
+  field_width = h.width;
+  row_words = h.row_words;
+
+  // the header can run ahead of a file that is being trimmed, never trust
+  // it past what is mapped
+  const std::size_t row_bytes = row_words * sizeof(uint64_t);
+  uint64_t mapped_rows = 0;
+  if (row_bytes > 0 && map_size >= mapped_rows_offset) {
+    mapped_rows = (map_size - mapped_rows_offset) / row_bytes;
+  }
+  rows = std::min<uint64_t>(h.rows, mapped_rows);
+
+  return rows;
+}
+
+uint64_t qca::mapped_row_reader::size() const {
+  return rows;
+}
+
+int qca::mapped_row_reader::width() const {
+  return field_width;
+}
+
+const uint64_t *qca::mapped_row_reader::row(const uint64_t n) const {
+  return reinterpret_cast<const uint64_t *>(
+    map + mapped_rows_offset + n * row_words * sizeof(uint64_t)
+  );
+}
+
+qca::packed_generation qca::mapped_row_reader::at(const uint64_t n) const {
+  const uint64_t *r = row(n);
+  return {field_width, std::vector<uint64_t>(r, r + row_words)};
+}
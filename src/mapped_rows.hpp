@@ -0,0 +1,100 @@
+#ifndef __MAPPED_ROWS_HPP__
+#define __MAPPED_ROWS_HPP__
+#include <cstddef>
+#include <cstdint>
+#include <string>
+
+#include "elementary.hpp"
+
+namespace qca {
+  // a file of bit-packed rows, each (width + 63) / 64 little endian words,
+  // after a fixed header:
+  //   0   "QCAROWS\0"
+  //   8   u32 version
+  //   12  u32 width
+  //   16  u64 rows written so far
+  //   24  u64 words per row
+  // rows start at mapped_rows_offset.
+  constexpr std::size_t mapped_rows_offset = 64;
+
+  // appends packed rows through a window of the file mapped shared. the file
+  // is grown a window at a time, and the pages behind the write head are
+  // written back and dropped from both the mapping and the page cache as it
+  // moves on, so a run far bigger than memory only ever holds a couple of
+  // windows' worth. the row count in the header is brought up to date each
+  // time, and every few thousand rows in between, so readers can follow a
+  // run while it is written.
+  class mapped_row_writer {
+  public:
+    mapped_row_writer(const std::string &path, const int width);
+    ~mapped_row_writer();
+
+    mapped_row_writer(const mapped_row_writer &) = delete;
+    mapped_row_writer &operator=(const mapped_row_writer &) = delete;
+
+    // false once opening, growing or mapping the file has failed
+    bool good() const;
+    void push(const packed_generation &g);
+    uint64_t size() const;
+
+    // publishes the row count to readers
+    void flush();
+    // trims the file to the rows written and closes it, also done on
+    // destruction
+    void close();
+
+    const int field_width;
+  private:
+    void write(const uint8_t *data, std::size_t n);
+    bool map_window(const std::size_t offset);
+    void unmap_window();
+    void release_behind();
+    void write_header();
+
+    int fd = -1;
+    bool ok = false;
+    std::size_t row_bytes = 0;
+    uint64_t rows = 0;
+
+    // the mapped window covers file bytes [window_offset, window_offset +
+    // window_size), and the write head is at `head`
+    uint8_t *window = nullptr;
+    std::size_t window_offset = 0;
+    std::size_t head = mapped_rows_offset;
+    // bytes before `released` are on disk and out of memory, bytes between
+    // it and `submitted` are being written back
+    std::size_t released = 0;
+    std::size_t submitted = 0;
+  };
+
+  // maps a row file read only. the file can still be growing: refresh()
+  // picks up any rows written since.
+  class mapped_row_reader {
+  public:
+    explicit mapped_row_reader(const std::string &path);
+    ~mapped_row_reader();
+
+    mapped_row_reader(const mapped_row_reader &) = delete;
+    mapped_row_reader &operator=(const mapped_row_reader &) = delete;
+
+    bool good() const;
+    // remaps the file if it has grown and returns the rows now readable
+    uint64_t refresh();
+    uint64_t size() const;
+    int width() const;
+
+    // row n, which must be below size(). the pointer stays valid until the
+    // next refresh()
+    const uint64_t *row(const uint64_t n) const;
+    packed_generation at(const uint64_t n) const;
+  private:
+    int fd = -1;
+    const uint8_t *map = nullptr;
+    std::size_t map_size = 0;
+    int field_width = 0;
+    std::size_t row_words = 0;
+    uint64_t rows = 0;
+  };
+}
+
+#endif // __MAPPED_ROWS_HPP__
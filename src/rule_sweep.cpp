@@ -0,0 +1,200 @@
+#include <array>
+#include <cstdint>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+#include "kernels.hpp"
+#include "rule_sweep.hpp"
+
+#if defined(__x86_64__) || defined(__i386__)
+#define QCA_X86
+#include <immintrin.h>
+#endif
+
+using slice = qca::rule_sweep::slice;
+
+// masks[n] has bit c set when code c takes neighbourhood n to 1
+static std::array<slice, 8> make_masks() {
+  std::array<slice, 8> masks{};
+  for (int n = 0; n < 8; ++n) {
+    for (int c = 0; c < 256; ++c) {
+      if ((c >> n) & 1) {
+        masks[n][c / 64] |= uint64_t{1} << (c % 64);
+      }
+    }
+  }
+
+  return masks;
+}
+
+static const std::array<slice, 8> masks = make_masks();
+
+// split on the left cell as in the step kernels, but with the masks differing
+// per rule rather than broadcast from one code
+static void step_scalar(const slice *cells, slice *out, const int w) {
+  for (int i = 0; i < w; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      const uint64_t l = cells[i - 1][j];
+      const uint64_t c = cells[i][j];
+      const uint64_t r = cells[i + 1][j];
+
+      const uint64_t cr = c & r;
+      const uint64_t c_nr = c & ~r;
+      const uint64_t nc_r = ~c & r;
+      const uint64_t nc_nr = ~(c | r);
+
+      const uint64_t g0 = (cr & masks[3][j]) | (c_nr & masks[2][j]) |
+        (nc_r & masks[1][j]) | (nc_nr & masks[0][j]);
+      const uint64_t g1 = (cr & masks[7][j]) | (c_nr & masks[6][j]) |
+        (nc_r & masks[5][j]) | (nc_nr & masks[4][j]);
+
+      out[i][j] = g0 ^ (l & (g0 ^ g1));
+    }
+  }
+}
+
+#ifdef QCA_X86
+// a whole cell is one 256 bit register, and each cell's right neighbour is
+// the next cell's centre, so the row streams through with one load per cell
+__attribute__((target("avx2")))
+static void step_avx2(const slice *cells, slice *out, const int w) {
+  __m256i m[8];
+  for (int n = 0; n < 8; ++n) {
+    m[n] = _mm256_loadu_si256((const __m256i *)masks[n].data());
+  }
+  const __m256i ones = _mm256_set1_epi64x(-1);
+
+  __m256i l = _mm256_loadu_si256((const __m256i *)cells[-1].data());
+  __m256i c = _mm256_loadu_si256((const __m256i *)cells[0].data());
+
+  for (int i = 0; i < w; ++i) {
+    const __m256i r = _mm256_loadu_si256((const __m256i *)cells[i + 1].data());
+
+    const __m256i cr = _mm256_and_si256(c, r);
+    const __m256i c_nr = _mm256_andnot_si256(r, c);
+    const __m256i nc_r = _mm256_andnot_si256(c, r);
+    const __m256i nc_nr = _mm256_andnot_si256(_mm256_or_si256(c, r), ones);
+
+    const __m256i g0 = _mm256_or_si256(
+      _mm256_or_si256(_mm256_and_si256(cr, m[3]), _mm256_and_si256(c_nr, m[2])),
+      _mm256_or_si256(_mm256_and_si256(nc_r, m[1]), _mm256_and_si256(nc_nr, m[0]))
+    );
+    const __m256i g1 = _mm256_or_si256(
+      _mm256_or_si256(_mm256_and_si256(cr, m[7]), _mm256_and_si256(c_nr, m[6])),
+      _mm256_or_si256(_mm256_and_si256(nc_r, m[5]), _mm256_and_si256(nc_nr, m[4]))
+    );
+
+    _mm256_storeu_si256(
+      (__m256i *)out[i].data(),
+      _mm256_xor_si256(g0, _mm256_and_si256(l, _mm256_xor_si256(g0, g1)))
+    );
+
+    l = c;
+    c = r;
+  }
+}
+#endif // QCA_X86
+
+qca::rule_sweep::rule_sweep(const generation &g, const boundary b)
+: field_width(g.size()), edges(b) {
+  front.resize(field_width + 2);
+  back.resize(field_width + 2);
+
+  for (int i = 0; i < field_width; ++i) {
+    const uint64_t fill = (g[i] & 1) ? ~uint64_t{0} : 0;
+    front[i + 1] = {fill, fill, fill, fill};
+  }
+}
+
+void qca::rule_sweep::next() {
+  if (field_width == 0) { return; }
+
+  static constexpr uint64_t ones = ~uint64_t{0};
+
+  slice *cells = front.data() + 1;
+  const int w = field_width;
+  switch (edges) {
+    case boundary::zero: cells[-1] = cells[w] = slice{}; break;
+    case boundary::one: cells[-1] = cells[w] = {ones, ones, ones, ones}; break;
+    case boundary::periodic:
+      cells[-1] = cells[w - 1];
+      cells[w] = cells[0];
+      break;
+    case boundary::reflect:
+      cells[-1] = cells[0];
+      cells[w] = cells[w - 1];
+      break;
+  }
+
+  slice *out = back.data() + 1;
+#ifdef QCA_X86
+  if (active_isa() >= isa::avx2) {
+    step_avx2(cells, out, w);
+  } else {
+    step_scalar(cells, out, w);
+  }
+#else
+  step_scalar(cells, out, w);
+#endif
+
+  std::swap(front, back);
+  gen_count++;
+}
+
+uint64_t qca::rule_sweep::generation_count() const {
+  return gen_count;
+}
+
+qca::packed_generation qca::rule_sweep::packed_row(const uint8_t code) const {
+  packed_generation p{field_width, {}};
+  p.words.assign((field_width + 63) / 64, 0);
+
+  const int word = code / 64;
+  const int bit = code % 64;
+  for (int i = 0; i < field_width; ++i) {
+    p.words[i / 64] |= ((front[i + 1][word] >> bit) & 1) << (i % 64);
+  }
+
+  return p;
+}
+
+qca::generation qca::rule_sweep::row(const uint8_t code) const {
+  return unpack(packed_row(code));
+}
+
+template <typename F>
+std::array<double, 256> qca::rule_sweep::count(const F &f) const {
+  std::array<uint64_t, 256> counts{};
+
+  for (int i = 1; i <= field_width; ++i) {
+    for (int j = 0; j < 4; ++j) {
+      for (uint64_t bits = f(i, j); bits != 0; bits &= bits - 1) {
+        counts[j * 64 + __builtin_ctzll(bits)]++;
+      }
+    }
+  }
+
+  std::array<double, 256> fractions{};
+  for (int c = 0; c < 256; ++c) {
+    fractions[c] = field_width ? double(counts[c]) / field_width : 0.0;
+  }
+
+  return fractions;
+}
+
+std::array<double, 256> qca::rule_sweep::density() const {
+  return count([&](const int i, const int j) {
+    return front[i][j];
+  });
+}
+
+std::array<double, 256> qca::rule_sweep::activity() const {
+  if (gen_count == 0) { return {}; }
+
+  // back still holds the generation before this one
+  return count([&](const int i, const int j) {
+    return front[i][j] ^ back[i][j];
+  });
+}
@@ -0,0 +1,48 @@
+#ifndef __RULE_SWEEP_HPP__
+#define __RULE_SWEEP_HPP__
+#include <array>
+#include <cstdint>
+#include <vector>
+
+#include "boundary.hpp"
+#include "elementary.hpp"
+
+namespace qca {
+  // evolves one initial row under all 256 wolfram codes at once.
+  //
+  // the row is bit-sliced across the rules: every cell is 256 bits, bit n
+  // holding its state under code n. a cell's neighbours are then just the
+  // words of the cells next to it, and each code bit becomes a 256 bit mask
+  // selecting which rules take that neighbourhood to 1, so one boolean
+  // evaluation per cell steps every rule.
+  class rule_sweep {
+  public:
+    using slice = std::array<uint64_t, 4>;
+
+    rule_sweep(const generation &g, const boundary b=boundary::zero);
+
+    void next();
+    uint64_t generation_count() const;
+
+    packed_generation packed_row(const uint8_t code) const;
+    generation row(const uint8_t code) const;
+
+    // fraction of cells set under each code
+    std::array<double, 256> density() const;
+    // fraction of cells that changed on the last step under each code
+    std::array<double, 256> activity() const;
+
+    const int field_width;
+  private:
+    template <typename F>
+    std::array<double, 256> count(const F &f) const;
+
+    // a ghost cell either side, next() writes back from front and swaps them
+    std::vector<slice> front;
+    std::vector<slice> back;
+    const boundary edges;
+    uint64_t gen_count = 0;
+  };
+}
+
+#endif // __RULE_SWEEP_HPP__
@@ -9,6 +9,10 @@ constexpr auto to_underlying(E e) noexcept {
 enum class error_code_t {
   not_enough_args = 1,
   too_many_args = 2,
+  invalid_rule = 3,
+  invalid_arg = 4,
+  write_failed = 5,
+  check_failed = 6,
   window_failed = 16,
   glad_failed = 17,
 
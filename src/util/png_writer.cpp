@@ -0,0 +1,217 @@
+#include <algorithm>
+#include <array>
+#include <cstddef>
+#include <cstdint>
+#include <cstdio>
+#include <cstdlib>
+#include <fstream>
+#include <string>
+#include <utility>
+#include <vector>
+
+#include <zlib.h>
+
+#include "png_writer.hpp"
+
+static constexpr std::size_t bytes_per_pixel = 3;
+static constexpr std::size_t idat_size = 1 << 16;
+
+// ihdr's data starts after the signature, its length and its type
+static constexpr std::streamoff ihdr_data = 16;
+static constexpr std::size_t ihdr_size = 13;
+
+static void put_u32(uint8_t *p, const uint32_t v) {
+  p[0] = v >> 24;
+  p[1] = v >> 16;
+  p[2] = v >> 8;
+  p[3] = v;
+}
+
+static std::array<uint8_t, ihdr_size> make_ihdr(
+  const std::size_t width, const std::size_t height
+) {
+  std::array<uint8_t, ihdr_size> ihdr{};
+  put_u32(ihdr.data(), width);
+  put_u32(ihdr.data() + 4, height);
+  ihdr[8] = 8;  // bit depth
+  ihdr[9] = 2;  // truecolour
+  return ihdr;
+}
+
+static uint32_t chunk_crc(
+  const char *type, const uint8_t *data, const std::size_t n
+) {
+  const uLong crc = crc32(0, reinterpret_cast<const Bytef *>(type), 4);
+  // a null buffer makes crc32 return its initial value rather than crc
+  return n ? crc32(crc, data, n) : crc;
+}
+
+static uint8_t paeth(const int a, const int b, const int c) {
+  const int p = a + b - c;
+  const int pa = std::abs(p - a);
+  const int pb = std::abs(p - b);
+  const int pc = std::abs(p - c);
+  if (pa <= pb && pa <= pc) { return a; }
+  return (pb <= pc) ? b : c;
+}
+
+// applies png filter type f to a row into out, returning the usual
+// heuristic for picking one: the sum of the filtered bytes taken as signed
+static uint64_t filter_row(
+  const int f, const uint8_t *row, const uint8_t *prev, const std::size_t n,
+  uint8_t *out
+) {
+  const std::size_t bpp = bytes_per_pixel;
+  uint64_t cost = 0;
+
+  for (std::size_t i = 0; i < n; ++i) {
+    const int a = (i >= bpp) ? row[i - bpp] : 0;
+    const int b = prev[i];
+    const int c = (i >= bpp) ? prev[i - bpp] : 0;
+
+    uint8_t predictor = 0;
+    switch (f) {
+      case 1: predictor = a; break;
+      case 2: predictor = b; break;
+      case 3: predictor = (a + b) / 2; break;
+      case 4: predictor = paeth(a, b, c); break;
+    }
+
+    out[i] = row[i] - predictor;
+    cost += std::abs(static_cast<int8_t>(out[i]));
+  }
+
+  return cost;
+}
+
+png::Writer::Writer(const std::string &path, const std::size_t width)
+: path(path), file(path, std::ios::binary), width(width) {
+  const std::size_t stride = width * bytes_per_pixel;
+  filtered.resize(stride + 1);
+  candidate.resize(stride + 1);
+  previous.assign(stride, 0);
+  out.resize(idat_size);
+
+  if (!file || deflateInit(&stream, Z_DEFAULT_COMPRESSION) != Z_OK) {
+    return;
+  }
+  ok = true;
+
+  static constexpr uint8_t signature[8] = {137, 80, 78, 71, 13, 10, 26, 10};
+  file.write(reinterpret_cast<const char *>(signature), sizeof(signature));
+
+  const auto ihdr = make_ihdr(width, 0);
+  write_chunk("IHDR", ihdr.data(), ihdr.size());
+
+  stream.next_out = out.data();
+  stream.avail_out = out.size();
+}
+
+png::Writer::~Writer() {
+  finish();
+}
+
+bool png::Writer::good() const {
+  return ok && file.good();
+}
+
+std::size_t png::Writer::rows() const {
+  return height;
+}
+
+void png::Writer::write_row(const uint8_t *rgb) {
+  if (!good() || finished) { return; }
+
+  const std::size_t stride = width * bytes_per_pixel;
+
+  // keep whichever filter looks cheapest in filtered, trying the others in
+  // candidate
+  filtered[0] = 0;
+  uint64_t best = filter_row(0, rgb, previous.data(), stride, &filtered[1]);
+  for (int f = 1; f <= 4 && best > 0; ++f) {
+    const uint64_t cost =
+      filter_row(f, rgb, previous.data(), stride, &candidate[1]);
+    if (cost < best) {
+      best = cost;
+      candidate[0] = f;
+      std::swap(filtered, candidate);
+    }
+  }
+
+  std::copy(rgb, rgb + stride, previous.begin());
+
+  stream.next_in = filtered.data();
+  stream.avail_in = filtered.size();
+  deflate_row(Z_NO_FLUSH);
+  height++;
+}
+
+bool png::Writer::finish() {
+  if (!ok || finished) { return good(); }
+  finished = true;
+
+  if (height == 0) {
+    deflateEnd(&stream);
+    file.close();
+    std::remove(path.c_str());
+    ok = false;
+    return false;
+  }
+
+  stream.next_in = nullptr;
+  stream.avail_in = 0;
+  deflate_row(Z_FINISH);
+  deflateEnd(&stream);
+
+  write_chunk("IEND", nullptr, 0);
+
+  // now the height is known, rewrite it and the crc that covers it
+  const auto ihdr = make_ihdr(width, height);
+  uint8_t crc[4];
+  put_u32(crc, chunk_crc("IHDR", ihdr.data(), ihdr.size()));
+
+  file.seekp(ihdr_data);
+  file.write(reinterpret_cast<const char *>(ihdr.data()), ihdr.size());
+  file.write(reinterpret_cast<const char *>(crc), sizeof(crc));
+  file.close();
+
+  return !file.fail();
+}
+
+void png::Writer::write_chunk(
+  const char *type, const uint8_t *data, const std::size_t size
+) {
+  uint8_t length[4];
+  uint8_t crc[4];
+  put_u32(length, size);
+  put_u32(crc, chunk_crc(type, data, size));
+
+  file.write(reinterpret_cast<const char *>(length), sizeof(length));
+  file.write(type, 4);
+  file.write(reinterpret_cast<const char *>(data), size);
+  file.write(reinterpret_cast<const char *>(crc), sizeof(crc));
+}
+
+// runs deflate over whatever is in next_in, writing an IDAT each time the
+// output fills. Z_FINISH also writes out the partial chunk left at the end.
+void png::Writer::deflate_row(const int flush) {
+  for (;;) {
+    const int result = deflate(&stream, flush);
+
+    const bool done = (flush == Z_FINISH && result == Z_STREAM_END);
+    if (stream.avail_out == 0 || done) {
+      const std::size_t pending = out.size() - stream.avail_out;
+      if (pending > 0) {
+        write_chunk("IDAT", out.data(), pending);
+      }
+      stream.next_out = out.data();
+      stream.avail_out = out.size();
+    }
+
+    if (flush == Z_FINISH) {
+      if (result == Z_STREAM_END || result == Z_STREAM_ERROR) { break; }
+    } else if (stream.avail_in == 0 && stream.avail_out != 0) {
+      break;
+    }
+  }
+}
@@ -0,0 +1,54 @@
+#ifndef __MODULE_PNG_WRITER_HPP__
+#define __MODULE_PNG_WRITER_HPP__
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <string>
+#include <vector>
+
+#include <zlib.h>
+
+namespace png {
+  // writes an 8 bit rgb png a row at a time. each row is filtered and fed to
+  // deflate as it arrives and full IDAT chunks go straight to the file, so
+  // memory stays O(width) however tall the image gets. the height is not
+  // needed up front, finish() patches it into the header.
+  class Writer {
+  public:
+    Writer(const std::string &path, const std::size_t width);
+    ~Writer();
+
+    Writer(const Writer &) = delete;
+    Writer &operator=(const Writer &) = delete;
+
+    // false once opening or writing the file has failed
+    bool good() const;
+    std::size_t rows() const;
+
+    // width * 3 bytes of rgb
+    void write_row(const uint8_t *rgb);
+    // flushes deflate, writes the trailer and the final height. called by
+    // the destructor if not called before. a png cannot be 0 rows tall, so
+    // with no rows written the file is removed and this is false.
+    bool finish();
+  private:
+    void write_chunk(const char *type, const uint8_t *data, std::size_t size);
+    void deflate_row(const int flush);
+
+    const std::string path;
+    std::ofstream file;
+    const std::size_t width;
+    std::size_t height = 0;
+    bool ok = false;
+    bool finished = false;
+
+    z_stream stream{};
+    // the filtered row (filter byte first) and the one before it unfiltered
+    std::vector<uint8_t> filtered;
+    std::vector<uint8_t> candidate;
+    std::vector<uint8_t> previous;
+    std::vector<uint8_t> out;
+  };
+}
+
+#endif // __MODULE_PNG_WRITER_HPP__
@@ -0,0 +1,172 @@
+#include <algorithm>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <iomanip>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "profiler.hpp"
+#include "timer.hpp"
+
+std::atomic<uint64_t> timing::Profiler::next_id{0};
+
+// below 8ns every value has its own bucket, above it each power of two is
+// split into 8
+std::size_t timing::Profiler::bucket(const uint64_t ns) {
+  if (ns < sub_buckets) { return ns; }
+
+  const int e = 63 - __builtin_clzll(ns);
+  const uint64_t sub = (ns >> (e - 3)) & (sub_buckets - 1);
+  return (e - 2) * sub_buckets + sub;
+}
+
+// the middle of a bucket
+uint64_t timing::Profiler::bucket_ns(const std::size_t b) {
+  if (b < sub_buckets) { return b; }
+
+  const int e = b / sub_buckets + 2;
+  const uint64_t low = (sub_buckets + b % sub_buckets) << (e - 3);
+  return low + (uint64_t{1} << (e - 3)) / 2;
+}
+
+std::size_t timing::Profiler::phase(const std::string_view name) {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  const auto it = std::find(names.begin(), names.end(), name);
+  if (it != names.end()) { return it - names.begin(); }
+  if (names.size() == max_phases) { return max_phases - 1; }
+
+  names.emplace_back(name);
+  return names.size() - 1;
+}
+
+void timing::Profiler::record(const std::size_t phase, const seconds duration) {
+  if (phase >= max_phases) { return; }
+
+  const double count = std::chrono::duration<double, std::nano>(duration)
+    .count();
+  const uint64_t ns = count > 0 ? uint64_t(count) : 0;
+
+  // only this thread writes its buffer, so a plain load and store is enough
+  // to keep the counters whole for readers
+  Buffer &b = local();
+  auto &n = b.counts[phase][bucket(ns)];
+  n.store(n.load(std::memory_order_relaxed) + 1, std::memory_order_relaxed);
+
+  auto &total = b.total_ns[phase];
+  total.store(
+    total.load(std::memory_order_relaxed) + ns, std::memory_order_relaxed
+  );
+
+  auto &max = b.max_ns[phase];
+  if (ns > max.load(std::memory_order_relaxed)) {
+    max.store(ns, std::memory_order_relaxed);
+  }
+}
+
+std::vector<timing::Profiler::Phase> timing::Profiler::summary() const {
+  std::lock_guard<std::mutex> lock(mutex);
+  std::vector<Phase> phases;
+
+  for (std::size_t p = 0; p < names.size(); ++p) {
+    std::array<uint64_t, buckets> counts{};
+    uint64_t total = 0;
+    uint64_t max = 0;
+
+    for (const auto &b : buffers) {
+      for (std::size_t i = 0; i < buckets; ++i) {
+        counts[i] += b->counts[p][i].load(std::memory_order_relaxed);
+      }
+      total += b->total_ns[p].load(std::memory_order_relaxed);
+      max = std::max(max, b->max_ns[p].load(std::memory_order_relaxed));
+    }
+
+    uint64_t count = 0;
+    for (const uint64_t c : counts) { count += c; }
+    if (count == 0) { continue; }
+
+    // the bucket holding the sample a fraction q of the way up
+    const auto percentile = [&](const double q) {
+      const uint64_t rank = std::max<uint64_t>(1, q * count + 0.5);
+      uint64_t seen = 0;
+      for (std::size_t i = 0; i < buckets; ++i) {
+        seen += counts[i];
+        if (seen >= rank) {
+          return std::min(bucket_ns(i), max);
+        }
+      }
+      return max;
+    };
+
+    const auto to_seconds = [](const uint64_t ns) {
+      return seconds(ns * 1e-9);
+    };
+
+    phases.push_back({
+      names[p], count, to_seconds(total), to_seconds(percentile(0.50)),
+      to_seconds(percentile(0.95)), to_seconds(percentile(0.99)),
+      to_seconds(max)
+    });
+  }
+
+  return phases;
+}
+
+void timing::Profiler::dump(std::ostream &out) const {
+  const auto ms = [](const seconds s) { return s.count() * 1e3; };
+
+  out << std::left << std::setw(12) << "phase" << std::right
+    << std::setw(10) << "count" << std::setw(10) << "mean ms"
+    << std::setw(10) << "p50 ms" << std::setw(10) << "p95 ms"
+    << std::setw(10) << "p99 ms" << std::setw(10) << "max ms" << "\n";
+
+  out << std::fixed << std::setprecision(3);
+  for (const Phase &p : summary()) {
+    out << std::left << std::setw(12) << p.name << std::right
+      << std::setw(10) << p.count
+      << std::setw(10) << ms(p.total) / p.count
+      << std::setw(10) << ms(p.p50) << std::setw(10) << ms(p.p95)
+      << std::setw(10) << ms(p.p99) << std::setw(10) << ms(p.max) << "\n";
+  }
+  out << std::defaultfloat;
+}
+
+void timing::Profiler::clear() {
+  std::lock_guard<std::mutex> lock(mutex);
+
+  for (const auto &b : buffers) {
+    for (auto &h : b->counts) {
+      for (auto &n : h) { n.store(0, std::memory_order_relaxed); }
+    }
+    for (auto &n : b->total_ns) { n.store(0, std::memory_order_relaxed); }
+    for (auto &n : b->max_ns) { n.store(0, std::memory_order_relaxed); }
+  }
+}
+
+// each thread finds its buffer in a short list of its own, the lock is
+// only taken the first time a thread records to a profiler
+timing::Profiler::Buffer &timing::Profiler::local() {
+  thread_local std::vector<std::pair<uint64_t, Buffer *>> mine;
+
+  for (const auto &[owner, buffer] : mine) {
+    if (owner == id) { return *buffer; }
+  }
+
+  std::lock_guard<std::mutex> lock(mutex);
+  buffers.push_back(std::make_unique<Buffer>());
+  mine.emplace_back(id, buffers.back().get());
+  return *buffers.back();
+}
+
+timing::Scope::Scope(Profiler &profiler, const std::size_t phase)
+: profiler(profiler), phase(phase), start(clock::now()) {}
+
+timing::Scope::~Scope() {
+  profiler.record(phase, clock::now() - start);
+}
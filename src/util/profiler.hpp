@@ -0,0 +1,92 @@
+#ifndef __MODULE_PROFILER_HPP__
+#define __MODULE_PROFILER_HPP__
+#include <array>
+#include <atomic>
+#include <cstddef>
+#include <cstdint>
+#include <memory>
+#include <mutex>
+#include <ostream>
+#include <string>
+#include <string_view>
+#include <vector>
+
+#include "timer.hpp"
+
+namespace timing {
+  // durations of named phases, kept as histograms. every thread records
+  // into a buffer of its own, so recording takes no lock and two threads
+  // never write the same counter, and summary() adds the buffers up.
+  //
+  // buckets are a power of two split eight ways, so a percentile is good to
+  // an eighth of its value from nanoseconds to minutes.
+  class Profiler {
+  public:
+    static constexpr std::size_t max_phases = 32;
+
+    struct Phase {
+      std::string name;
+      uint64_t count;
+      seconds total;
+      seconds p50;
+      seconds p95;
+      seconds p99;
+      seconds max;
+    };
+
+    Profiler() = default;
+    Profiler(const Profiler &) = delete;
+    Profiler &operator=(const Profiler &) = delete;
+
+    // the id of a named phase, adding it if it is new. the same name always
+    // gets the same id, past max_phases everything goes to the last one.
+    std::size_t phase(const std::string_view name);
+    void record(const std::size_t phase, const seconds duration);
+
+    // phases that have been recorded, in the order they were added
+    std::vector<Phase> summary() const;
+    void dump(std::ostream &out) const;
+    void clear();
+  private:
+    static constexpr int sub_buckets = 8;
+    static constexpr std::size_t buckets = 64 * sub_buckets;
+
+    using histogram = std::array<std::atomic<uint64_t>, buckets>;
+
+    // written only by the thread that owns it, read by anyone
+    struct Buffer {
+      std::array<histogram, max_phases> counts{};
+      std::array<std::atomic<uint64_t>, max_phases> total_ns{};
+      std::array<std::atomic<uint64_t>, max_phases> max_ns{};
+    };
+
+    static std::size_t bucket(const uint64_t ns);
+    static uint64_t bucket_ns(const std::size_t b);
+    Buffer &local();
+
+    // tells profilers apart in each thread's list of its buffers, an
+    // address could be reused
+    const uint64_t id = next_id++;
+    static std::atomic<uint64_t> next_id;
+
+    mutable std::mutex mutex;
+    std::vector<std::string> names;
+    std::vector<std::unique_ptr<Buffer>> buffers;
+  };
+
+  // records the time from construction to destruction as a phase
+  class Scope {
+  public:
+    Scope(Profiler &profiler, const std::size_t phase);
+    ~Scope();
+
+    Scope(const Scope &) = delete;
+    Scope &operator=(const Scope &) = delete;
+  private:
+    Profiler &profiler;
+    const std::size_t phase;
+    const time_point start;
+  };
+}
+
+#endif // __MODULE_PROFILER_HPP__
@@ -0,0 +1,80 @@
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+
+#include "thread_pool.hpp"
+#include "trace.hpp"
+
+static constexpr int spin_limit = 4096;
+
+threading::Barrier::Barrier(const std::size_t count)
+: count(count), waiting(0), phase(0) {}
+
+void threading::Barrier::wait() {
+  const std::size_t current = phase.load(std::memory_order_acquire);
+
+  if (waiting.fetch_add(1, std::memory_order_acq_rel) + 1 == count) {
+    // nobody can arrive for the next phase until phase moves on, so the
+    // counter is safe to reset here
+    waiting.store(0, std::memory_order_relaxed);
+    {
+      std::lock_guard<std::mutex> lock(mutex);
+      phase.store(current + 1, std::memory_order_release);
+    }
+    cv.notify_all();
+    return;
+  }
+
+  for (int i = 0; i < spin_limit; ++i) {
+    if (phase.load(std::memory_order_acquire) != current) { return; }
+    std::this_thread::yield();
+  }
+
+  std::unique_lock<std::mutex> lock(mutex);
+  cv.wait(lock, [&]{
+    return phase.load(std::memory_order_acquire) != current;
+  });
+}
+
+threading::Pool::Pool(const std::size_t threads)
+: start(threads == 0 ? 1 : threads), finish(threads == 0 ? 1 : threads) {
+  for (std::size_t i = 1; i < threads; ++i) {
+    workers.emplace_back(&Pool::work, this, i);
+  }
+}
+
+threading::Pool::~Pool() {
+  stopping = true;
+  start.wait();
+
+  for (auto &t : workers) {
+    t.join();
+  }
+}
+
+std::size_t threading::Pool::size() const {
+  return workers.size() + 1;
+}
+
+void threading::Pool::run_job(const job f, const void *context) {
+  current_job = f;
+  current_context = context;
+
+  start.wait();
+  f(context, 0, size());
+  finish.wait();
+}
+
+void threading::Pool::work(const std::size_t index) {
+  tracing::name_thread("pool worker");
+
+  while (true) {
+    start.wait();
+    if (stopping) { return; }
+
+    current_job(current_context, index, size());
+    finish.wait();
+  }
+}
@@ -0,0 +1,69 @@
+#ifndef __MODULE_THREAD_POOL_HPP__
+#define __MODULE_THREAD_POOL_HPP__
+#include <atomic>
+#include <condition_variable>
+#include <cstddef>
+#include <mutex>
+#include <thread>
+#include <vector>
+
+namespace threading {
+  // reusable barrier for a fixed number of threads. waiters spin briefly
+  // before sleeping, so back to back phases stay cheap while an idle pool
+  // does not burn cpu.
+  class Barrier {
+  public:
+    explicit Barrier(const std::size_t count);
+
+    void wait();
+  private:
+    const std::size_t count;
+    std::atomic<std::size_t> waiting;
+    std::atomic<std::size_t> phase;
+
+    std::mutex mutex;
+    std::condition_variable cv;
+  };
+
+  // fixed set of threads that run the same job together, the calling thread
+  // takes part as index 0
+  class Pool {
+  public:
+    explicit Pool(const std::size_t threads);
+    ~Pool();
+
+    Pool(const Pool &) = delete;
+    Pool &operator=(const Pool &) = delete;
+
+    std::size_t size() const;
+
+    // runs f(i, size()) on every thread and returns once all have finished.
+    // f is called through a plain function pointer rather than copied into a
+    // std::function, so running a job never allocates.
+    template <typename F>
+    void run(const F &f) {
+      run_job(
+        [](const void *context, std::size_t index, std::size_t count) {
+          (*static_cast<const F *>(context))(index, count);
+        },
+        &f
+      );
+    }
+  private:
+    using job = void (*)(
+      const void *context, std::size_t index, std::size_t count
+    );
+
+    void run_job(const job f, const void *context);
+    void work(const std::size_t index);
+
+    std::vector<std::thread> workers;
+    Barrier start;
+    Barrier finish;
+    job current_job = nullptr;
+    const void *current_context = nullptr;
+    bool stopping = false;
+  };
+}
+
+#endif // __MODULE_THREAD_POOL_HPP__
@@ -0,0 +1,148 @@
+#include <atomic>
+#include <chrono>
+#include <cstdint>
+#include <cstdlib>
+#include <fstream>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <mutex>
+#include <string>
+#include <vector>
+
+#include "trace.hpp"
+
+std::atomic<bool> tracing::recording{false};
+
+namespace {
+  using clock = std::chrono::steady_clock;
+
+  struct event {
+    const char *name;
+    char phase;
+    clock::time_point time;
+  };
+
+  // only its own thread appends, the lock is there for the writer at the
+  // end and is otherwise never contended
+  struct buffer {
+    std::mutex mutex;
+    int tid = 0;
+    const char *name = nullptr;
+    std::vector<event> events;
+  };
+
+  struct registry {
+    std::mutex mutex;
+    std::vector<std::shared_ptr<buffer>> buffers;
+    clock::time_point epoch;
+  };
+
+  registry &all() {
+    static registry r;
+    return r;
+  }
+
+  buffer &local() {
+    thread_local std::shared_ptr<buffer> mine = []() {
+      auto b = std::make_shared<buffer>();
+      registry &r = all();
+      std::lock_guard<std::mutex> lock(r.mutex);
+      b->tid = r.buffers.size() + 1;
+      r.buffers.push_back(b);
+      return b;
+    }();
+
+    return *mine;
+  }
+
+  void add(const char *name, const char phase) {
+    buffer &b = local();
+    std::lock_guard<std::mutex> lock(b.mutex);
+    b.events.push_back({name, phase, clock::now()});
+  }
+
+  // names are only ever literals from the code, but quotes and backslashes
+  // would still break the json
+  void write_string(std::ostream &out, const char *s) {
+    out << '"';
+    for (; *s; ++s) {
+      if (*s == '"' || *s == '\\') { out << '\\'; }
+      out << *s;
+    }
+    out << '"';
+  }
+}
+
+void tracing::begin(const char *name) {
+  if (recording.load(std::memory_order_relaxed)) { add(name, 'B'); }
+}
+
+void tracing::end(const char *name) {
+  if (recording.load(std::memory_order_relaxed)) { add(name, 'E'); }
+}
+
+void tracing::name_thread(const char *name) {
+  buffer &b = local();
+  std::lock_guard<std::mutex> lock(b.mutex);
+  b.name = name;
+}
+
+tracing::Session::Session(const char *variable) {
+  const char *value = std::getenv(variable);
+  if (value == nullptr || *value == '\0') { return; }
+
+  path = value;
+  all().epoch = clock::now();
+  recording.store(true, std::memory_order_relaxed);
+}
+
+tracing::Session::~Session() {
+  if (!active()) { return; }
+  recording.store(false, std::memory_order_relaxed);
+
+  std::ofstream out(path);
+  out << std::fixed << std::setprecision(3);
+  out << "{\"displayTimeUnit\": \"ms\", \"traceEvents\": [";
+
+  registry &r = all();
+  std::lock_guard<std::mutex> lock(r.mutex);
+  bool first = true;
+
+  for (const auto &b : r.buffers) {
+    std::lock_guard<std::mutex> l(b->mutex);
+
+    if (b->name) {
+      out << (first ? "" : ",") << "\n{\"ph\": \"M\", \"pid\": 1, \"tid\": "
+        << b->tid << ", \"name\": \"thread_name\", \"args\": {\"name\": ";
+      write_string(out, b->name);
+      out << "}}";
+      first = false;
+    }
+
+    // microseconds since the session started
+    for (const event &e : b->events) {
+      const double us =
+        std::chrono::duration<double, std::micro>(e.time - r.epoch).count();
+
+      out << (first ? "" : ",") << "\n{\"ph\": \"" << e.phase
+        << "\", \"pid\": 1, \"tid\": " << b->tid << ", \"ts\": " << us
+        << ", \"name\": ";
+      write_string(out, e.name);
+      out << "}";
+      first = false;
+    }
+    b->events.clear();
+  }
+
+  out << "\n]}\n";
+  if (!out) {
+    std::cerr << "Failed to write trace " << path << "\n";
+  } else {
+    std::cout << "Trace: " << path << "\n";
+  }
+}
+
+bool tracing::Session::active() const {
+  return !path.empty();
+}
@@ -0,0 +1,56 @@
+#ifndef __MODULE_TRACE_HPP__
+#define __MODULE_TRACE_HPP__
+#include <atomic>
+#include <string>
+
+namespace tracing {
+  // spans of work on a timeline, written out as chrome trace event json for
+  // chrome://tracing or perfetto. nothing is recorded unless a Session is,
+  // and until then a span costs one relaxed load.
+  //
+  // each thread appends to a buffer of its own, tagged with its id and any
+  // name it has been given. names must outlive the session, in practice
+  // they are string literals.
+  extern std::atomic<bool> recording;
+
+  // for spans that do not fit a scope, both do nothing unless recording
+  void begin(const char *name);
+  void end(const char *name);
+  // labels the calling thread in the trace
+  void name_thread(const char *name);
+
+  // a begin event on construction and the matching end on destruction
+  class Span {
+  public:
+    explicit Span(const char *name)
+    : name(recording.load(std::memory_order_relaxed) ? name : nullptr) {
+      if (this->name) { begin(this->name); }
+    }
+    // ends only what it began, however the session changed in between
+    ~Span() {
+      if (name) { end(name); }
+    }
+
+    Span(const Span &) = delete;
+    Span &operator=(const Span &) = delete;
+  private:
+    const char *name;
+  };
+
+  // records while it exists if the environment variable names a file, and
+  // writes the trace there when it goes
+  class Session {
+  public:
+    explicit Session(const char *variable="QCA_TRACE");
+    ~Session();
+
+    Session(const Session &) = delete;
+    Session &operator=(const Session &) = delete;
+
+    bool active() const;
+  private:
+    std::string path;
+  };
+}
+
+#endif // __MODULE_TRACE_HPP__
@@ -0,0 +1,416 @@
+#include <algorithm>
+#include <charconv>
+#include <chrono>
+#include <cmath>
+#include <cstddef>
+#include <cstdint>
+#include <fstream>
+#include <functional>
+#include <iomanip>
+#include <iostream>
+#include <memory>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <utility>
+#include <vector>
+
+#include "elementary.hpp"
+#include "kernels.hpp"
+#include "rule_sweep.hpp"
+#include "util/error.hpp"
+#include "util/png_writer.hpp"
+
+// microbenchmarks for the simulation and output hot paths. each case is
+// warmed up while its batch size is found, then timed over several batches
+// of that size. every op is one generation, one init, one row or one
+// picture, done to `cells` cells, so ns/op is ns/generation for the step and
+// cells/s compares across cases.
+
+using timer = std::chrono::steady_clock;
+
+struct options {
+  int repetitions = 10;
+  double min_time = 0.05;
+  // threads each step is split across, see elementary::set_threads
+  int threads = 1;
+  std::string filter;
+  std::string json;
+};
+
+// runs the case n times
+using runner = std::function<void(uint64_t n)>;
+
+struct bench_case {
+  std::string name;
+  uint64_t cells;
+  // builds whatever the case works on, outside the timing
+  std::function<runner()> setup;
+};
+
+struct result {
+  std::string name;
+  uint64_t cells;
+  uint64_t iterations;
+  std::vector<double> ns;
+};
+
+// keeps the optimiser from dropping work whose result is never used
+static volatile uint64_t sink = 0;
+
+static void usage(const char *name) {
+  std::cerr << "usage: " << name << " [options]\n"
+    << "  -r REPS       timed repetitions of each case (10)\n"
+    << "  -t SECONDS    least time per repetition (0.05)\n"
+    << "  -f FILTER     only cases whose name contains FILTER\n"
+    << "  -p THREADS    threads to split each step across (1)\n"
+    << "  -j FILE       also write the results as json to FILE\n";
+}
+
+// a whole number of at least 1
+static std::optional<int> parse_count(const std::string_view value) {
+  int n = 0;
+  const auto [end, error] =
+    std::from_chars(value.data(), value.data() + value.size(), n);
+  if (error != std::errc{} || end != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  if (n < 1) { return std::nullopt; }
+
+  return n;
+}
+
+static std::optional<options> parse_options(
+  const int argc, const char *argv[]
+) {
+  options o;
+
+  for (int i = 1; i < argc; i += 2) {
+    const std::string_view flag = argv[i];
+    if (i + 1 >= argc) { return std::nullopt; }
+    const std::string_view value = argv[i + 1];
+
+    if (flag == "-r") {
+      const std::optional<int> n = parse_count(value);
+      if (!n) { return std::nullopt; }
+      o.repetitions = *n;
+    } else if (flag == "-p") {
+      const std::optional<int> n = parse_count(value);
+      if (!n) { return std::nullopt; }
+      o.threads = *n;
+    } else if (flag == "-t") {
+      std::stringstream ss{std::string(value)};
+      if (!(ss >> o.min_time) || o.min_time <= 0) { return std::nullopt; }
+    } else if (flag == "-f") {
+      o.filter = value;
+    } else if (flag == "-j") {
+      o.json = value;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  return o;
+}
+
+static std::string width_name(const int width) {
+  if (width >= (1 << 20) && width % (1 << 20) == 0) {
+    return std::to_string(width >> 20) + "M";
+  }
+  if (width >= (1 << 10) && width % (1 << 10) == 0) {
+    return std::to_string(width >> 10) + "K";
+  }
+  return std::to_string(width);
+}
+
+static qca::elementary random_field(const int width, const uint8_t code) {
+  qca::elementary ca(width, 1, qca::wolfram(code));
+  ca.seed(1);
+  ca.init_random();
+  return ca;
+}
+
+static std::vector<bench_case> make_cases(const options &o) {
+  const int threads = o.threads;
+  std::vector<bench_case> cases;
+
+  for (const int width : {256, 4096, 1 << 16, 1 << 20}) {
+    for (const uint8_t code : {30, 90, 110}) {
+      cases.push_back({
+        "next/rule_" + std::to_string(code) + "/" + width_name(width),
+        uint64_t(width),
+        [=]() -> runner {
+          auto ca =
+            std::make_shared<qca::elementary>(random_field(width, code));
+          ca->set_threads(threads);
+          return [ca](const uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) { ca->next(); }
+          };
+        }
+      });
+    }
+  }
+
+  // every code one generation on from the same row: the bit-sliced sweep
+  // against 256 separate packed runs, both on one thread whatever -p says
+  for (const int width : {4096, 1 << 16}) {
+    cases.push_back({
+      "all_rules/sweep/" + width_name(width), uint64_t(width) * 256,
+      [=]() -> runner {
+        auto sweep = std::make_shared<qca::rule_sweep>(
+          random_field(width, 0).get()
+        );
+        return [sweep](const uint64_t n) {
+          for (uint64_t i = 0; i < n; ++i) { sweep->next(); }
+        };
+      }
+    });
+    cases.push_back({
+      "all_rules/next/" + width_name(width), uint64_t(width) * 256,
+      [=]() -> runner {
+        auto runs = std::make_shared<std::vector<qca::elementary>>();
+        for (int code = 0; code < 256; ++code) {
+          runs->push_back(random_field(width, code));
+        }
+        return [runs](const uint64_t n) {
+          for (uint64_t i = 0; i < n; ++i) {
+            for (qca::elementary &ca : *runs) { ca.next(); }
+          }
+        };
+      }
+    });
+  }
+
+  for (const int width : {4096, 1 << 20}) {
+    for (const qca::init_mode m : {
+      qca::init_mode::single_0, qca::init_mode::single_1,
+      qca::init_mode::alternate, qca::init_mode::random
+    }) {
+      cases.push_back({
+        std::string("init/") + qca::init_mode_name(m) + "/" + width_name(width),
+        uint64_t(width),
+        [=]() -> runner {
+          auto ca = std::make_shared<qca::elementary>(random_field(width, 30));
+          return [ca, m](const uint64_t n) {
+            for (uint64_t i = 0; i < n; ++i) { ca->init(m); }
+          };
+        }
+      });
+    }
+  }
+
+  for (const int width : {4096, 1 << 20}) {
+    cases.push_back({
+      "colour/generation/" + width_name(width), uint64_t(width),
+      [=]() -> runner {
+        const qca::elementary ca = random_field(width, 30);
+        auto g = std::make_shared<qca::generation>(ca.get());
+        auto rgb = std::make_shared<std::vector<uint8_t>>(3 * width);
+        return [g, rgb, colours = qca::greyscale(2)](const uint64_t n) {
+          for (uint64_t i = 0; i < n; ++i) {
+            qca::cells_to_colour(*g, colours, rgb->data());
+            sink = sink + (*rgb)[i % rgb->size()];
+          }
+        };
+      }
+    });
+    cases.push_back({
+      "colour/packed/" + width_name(width), uint64_t(width),
+      [=]() -> runner {
+        const qca::elementary ca = random_field(width, 30);
+        auto p = std::make_shared<qca::packed_generation>(ca.get_packed());
+        auto rgb = std::make_shared<std::vector<uint8_t>>(3 * width);
+        return [p, rgb, colours = qca::greyscale(2)](const uint64_t n) {
+          for (uint64_t i = 0; i < n; ++i) {
+            qca::cells_to_colour(*p, colours, rgb->data());
+            sink = sink + (*rgb)[i % rgb->size()];
+          }
+        };
+      }
+    });
+  }
+
+  // the whole-picture overload the viewer's field is drawn with, the same
+  // rows a running rule 30 gives. one op is the picture.
+  for (const auto [width, rows] : {
+    std::pair{800, 200}, std::pair{4096, 256}
+  }) {
+    cases.push_back({
+      "colour/history/" + width_name(width) + "x" + std::to_string(rows),
+      uint64_t(width) * rows,
+      [=]() -> runner {
+        auto h = std::make_shared<qca::history>();
+        qca::elementary ca = random_field(width, 30);
+        for (int r = 0; r < rows; ++r) {
+          h->push_back(ca.get());
+          ca.next();
+        }
+
+        return [h, width, rows, colours = qca::greyscale(2)](
+          const uint64_t n
+        ) {
+          for (uint64_t i = 0; i < n; ++i) {
+            const std::vector<uint8_t> rgb =
+              qca::cells_to_colour(*h, colours, width, rows);
+            sink = sink + rgb[i % rgb.size()];
+          }
+        };
+      }
+    });
+  }
+
+  // rows of a running rule 30, so deflate sees a realistic picture, encoded
+  // to nowhere so the disk stays out of it
+  for (const int width : {800, 4096}) {
+    cases.push_back({
+      "png/row/" + width_name(width), uint64_t(width),
+      [=]() -> runner {
+        static constexpr int rows = 256;
+        auto image = std::make_shared<std::vector<uint8_t>>(3 * width * rows);
+        qca::elementary ca = random_field(width, 30);
+        for (int r = 0; r < rows; ++r) {
+          qca::cells_to_colour(
+            ca.get_packed(), ca.get_palette(), image->data() + 3 * width * r
+          );
+          ca.next();
+        }
+
+        return [=](const uint64_t n) {
+          png::Writer png("/dev/null", width);
+          for (uint64_t i = 0; i < n; ++i) {
+            png.write_row(image->data() + 3 * width * (i % rows));
+          }
+          png.finish();
+        };
+      }
+    });
+  }
+
+  return cases;
+}
+
+static double time_ns(const runner &run, const uint64_t n) {
+  const auto start = timer::now();
+  run(n);
+  const auto end = timer::now();
+
+  return std::chrono::duration<double, std::nano>(end - start).count();
+}
+
+// doubles the batch until it takes min_time, which doubles as the warm-up
+static result measure(
+  const bench_case &c, const runner &run, const options &o
+) {
+  const double target = o.min_time * 1e9;
+  uint64_t n = 1;
+  while (time_ns(run, n) < target && n < (uint64_t{1} << 40)) {
+    n *= 2;
+  }
+
+  result r{c.name, c.cells, n, {}};
+  for (int i = 0; i < o.repetitions; ++i) {
+    r.ns.push_back(time_ns(run, n) / n);
+  }
+
+  return r;
+}
+
+struct stats {
+  double min;
+  double median;
+  double mean;
+  double stddev;
+  double max;
+};
+
+static stats summarise(std::vector<double> ns) {
+  std::sort(ns.begin(), ns.end());
+
+  stats s{ns.front(), 0.0, 0.0, 0.0, ns.back()};
+  const std::size_t n = ns.size();
+  s.median = (n % 2) ? ns[n / 2] : (ns[n / 2 - 1] + ns[n / 2]) / 2;
+
+  for (const double v : ns) { s.mean += v; }
+  s.mean /= n;
+  for (const double v : ns) { s.stddev += (v - s.mean) * (v - s.mean); }
+  s.stddev = (n > 1) ? std::sqrt(s.stddev / (n - 1)) : 0.0;
+
+  return s;
+}
+
+static void write_json(
+  std::ostream &out, const std::vector<result> &results, const options &o
+) {
+  out << std::setprecision(6);
+  out << "{\n"
+    << "  \"isa\": \"" << qca::isa_name(qca::active_isa()) << "\",\n"
+    << "  \"threads\": " << o.threads << ",\n"
+    << "  \"hardware_threads\": " << std::thread::hardware_concurrency()
+    << ",\n"
+    << "  \"compiler\": \"" << __VERSION__ << "\",\n"
+    << "  \"repetitions\": " << o.repetitions << ",\n"
+    << "  \"benchmarks\": [";
+
+  for (std::size_t i = 0; i < results.size(); ++i) {
+    const result &r = results[i];
+    const stats s = summarise(r.ns);
+
+    out << (i ? "," : "") << "\n    {"
+      << "\"name\": \"" << r.name << "\", "
+      << "\"cells\": " << r.cells << ", "
+      << "\"iterations\": " << r.iterations << ", "
+      << "\"ns_per_op\": {"
+      << "\"min\": " << s.min << ", "
+      << "\"median\": " << s.median << ", "
+      << "\"mean\": " << s.mean << ", "
+      << "\"stddev\": " << s.stddev << ", "
+      << "\"max\": " << s.max << "}, "
+      << "\"cells_per_second\": " << r.cells * 1e9 / s.median << "}";
+  }
+
+  out << "\n  ]\n}\n";
+}
+
+int main(int argc, const char *argv[]) {
+  const std::optional<options> o = parse_options(argc, argv);
+  if (!o) {
+    usage(argv[0]);
+    return to_underlying(error_code_t::invalid_arg);
+  }
+
+  std::cout << "Kernel: " << qca::isa_name(qca::active_isa()) << "\n";
+  std::cout << "Threads: " << o->threads << "\n";
+  std::cout << std::left << std::setw(28) << "case"
+    << std::right << std::setw(14) << "ns/op"
+    << std::setw(10) << "+/-%"
+    << std::setw(14) << "Mcells/s" << "\n";
+
+  std::vector<result> results;
+  for (const bench_case &c : make_cases(*o)) {
+    if (c.name.find(o->filter) == std::string::npos) { continue; }
+
+    const runner run = c.setup();
+    results.push_back(measure(c, run, *o));
+
+    const stats s = summarise(results.back().ns);
+    std::cout << std::left << std::setw(28) << c.name << std::right
+      << std::fixed << std::setprecision(1)
+      << std::setw(14) << s.median
+      << std::setw(10) << 100 * s.stddev / s.mean
+      << std::setw(14) << c.cells * 1e3 / s.median << "\n"
+      << std::defaultfloat;
+  }
+
+  if (!o->json.empty()) {
+    std::ofstream file(o->json);
+    write_json(file, results, *o);
+    if (!file) {
+      std::cerr << "cannot write " << o->json << "\n";
+      return to_underlying(error_code_t::write_failed);
+    }
+  }
+
+  return 0;
+}
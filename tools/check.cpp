@@ -0,0 +1,592 @@
+#include <array>
+#include <charconv>
+#include <cstdio>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <optional>
+#include <random>
+#include <string>
+#include <string_view>
+#include <utility>
+#include <vector>
+
+#include "boundary.hpp"
+#include "checkpoint.hpp"
+#include "elementary.hpp"
+#include "ensemble.hpp"
+#include "hashlife.hpp"
+#include "history.hpp"
+#include "kernels.hpp"
+#include "mapped_rows.hpp"
+#include "rule_sweep.hpp"
+#include "util/error.hpp"
+
+// checks the engines against references they do not share code with.
+// the packed engine is checked against a cell at a time reference: every
+// wolfram code, every boundary, from random rows of widths either side of
+// each word and of each point where a step is split into more chunks. the
+// engine steps on the active kernel (set QCA_ISA to pick another) split
+// across -p threads, the result has to be bit-identical. the rest are
+// checked against the packed engine.
+
+struct options {
+  int threads = 4;
+  int generations = 16;
+  uint32_t seed = 1;
+  std::string filter;
+};
+
+static void usage(const char *name) {
+  std::cerr << "usage: " << name << " [options]\n"
+    << "  -p THREADS    threads to split each step across (4)\n"
+    << "  -g GENS       generations stepped from each row (16)\n"
+    << "  -s SEED       seed for the random rows (1)\n"
+    << "  -f FILTER     only checks whose name contains FILTER\n";
+}
+
+// a whole number of at least 1
+static std::optional<int> parse_count(const std::string_view value) {
+  int n = 0;
+  const auto [end, error] =
+    std::from_chars(value.data(), value.data() + value.size(), n);
+  if (error != std::errc{} || end != value.data() + value.size()) {
+    return std::nullopt;
+  }
+  if (n < 1) { return std::nullopt; }
+
+  return n;
+}
+
+static std::optional<options> parse_options(
+  const int argc, const char *argv[]
+) {
+  options o;
+
+  for (int i = 1; i < argc; i += 2) {
+    const std::string_view flag = argv[i];
+    if (i + 1 >= argc) { return std::nullopt; }
+    if (flag == "-f") {
+      o.filter = argv[i + 1];
+      continue;
+    }
+
+    const std::optional<int> n = parse_count(argv[i + 1]);
+    if (!n) { return std::nullopt; }
+
+    if (flag == "-p") {
+      o.threads = *n;
+    } else if (flag == "-g") {
+      o.generations = *n;
+    } else if (flag == "-s") {
+      o.seed = *n;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  return o;
+}
+
+// every width up to a few words, then either side of each multiple of the
+// 256 words a thread is given at least
+static std::vector<int> widths() {
+  std::vector<int> w;
+  for (int i = 1; i <= 200; ++i) { w.push_back(i); }
+  for (const int words : {256, 512, 1024}) {
+    for (const int d : {-64, -1, 0, 1}) {
+      w.push_back(64 * words + d);
+    }
+  }
+  w.push_back(40000);
+
+  return w;
+}
+
+static constexpr qca::boundary boundaries[] = {
+  qca::boundary::zero, qca::boundary::one,
+  qca::boundary::periodic, qca::boundary::reflect
+};
+
+static qca::generation reference_next(
+  const qca::generation &g, const uint8_t code, const qca::boundary b
+) {
+  const int width = g.size();
+  uint8_t l = 0;
+  uint8_t r = 0;
+  switch (b) {
+    case qca::boundary::zero: l = 0; r = 0; break;
+    case qca::boundary::one: l = 1; r = 1; break;
+    case qca::boundary::periodic: l = g[width - 1]; r = g[0]; break;
+    case qca::boundary::reflect: l = g[0]; r = g[width - 1]; break;
+  }
+
+  qca::generation next(width);
+  for (int i = 0; i < width; ++i) {
+    const int left = (i == 0) ? l : g[i - 1];
+    const int right = (i == width - 1) ? r : g[i + 1];
+    next[i] = (code >> (left << 2 | g[i] << 1 | right)) & 1;
+  }
+
+  return next;
+}
+
+// failures so far, reported once each
+static uint64_t failures = 0;
+
+static void fail(const std::string &what) {
+  std::cerr << what << "\n";
+  failures++;
+}
+
+static void report(
+  const char *name, const uint64_t runs, const uint64_t failed
+) {
+  std::cout << name << ": " << runs - failed << "/" << runs << " match\n";
+}
+
+static void check_step(const options &o) {
+  const uint64_t before = failures;
+  uint64_t runs = 0;
+
+  for (const int width : widths()) {
+    // one engine per width, so its threads are started once
+    qca::elementary ca(width, 1, qca::wolfram(0));
+    ca.set_threads(o.threads);
+
+    for (const qca::boundary b : boundaries) {
+      for (int code = 0; code < 256; ++code) {
+        ca.set_rules(qca::wolfram(code));
+        ca.set_boundary(b);
+        ca.seed(o.seed + width);
+        ca.init_random();
+
+        qca::generation expected = ca.get();
+        for (int n = 1; n <= o.generations; ++n) {
+          ca.next();
+          expected = reference_next(expected, code, b);
+
+          if (ca.get() != expected) {
+            fail(
+              "step: rule " + std::to_string(code) + ", width " +
+              std::to_string(width) + ", " + qca::boundary_name(b) +
+              ": differs at generation " + std::to_string(n)
+            );
+            break;
+          }
+        }
+        runs++;
+      }
+    }
+  }
+
+  report("step", runs, failures - before);
+}
+
+// a run saved part way and loaded into a fresh engine carries on as the
+// run that was never stopped, random rows drawn afterwards included
+static void check_checkpoint(const options &o) {
+  const uint64_t before = failures;
+  const std::string path =
+    (std::filesystem::temp_directory_path() / "qca_check.qcp").string();
+  uint64_t runs = 0;
+
+  for (const int width : {1, 64, 100, 1000}) {
+    for (const qca::boundary b : boundaries) {
+      for (const int code : {30, 90, 110, 184}) {
+        qca::elementary ca(width, 1, qca::wolfram(code), b);
+        ca.set_cycle_detection(true);
+        ca.seed(o.seed);
+        ca.init_random();
+        for (int n = 0; n < o.generations; ++n) { ca.next(); }
+
+        const std::string name = "checkpoint: rule " + std::to_string(code) +
+          ", width " + std::to_string(width) + ", " + qca::boundary_name(b);
+        runs++;
+
+        const std::optional<qca::elementary_state> state =
+          qca::write_checkpoint(path, ca.get_state())
+            ? qca::read_checkpoint(path) : std::nullopt;
+        qca::elementary resumed(1, 1, qca::wolfram(0));
+        if (!state || !resumed.set_state(*state)) {
+          fail(name + ": does not load");
+          continue;
+        }
+        if (state->seed != o.seed || state->init != qca::init_mode::random) {
+          fail(name + ": loses the seed or init mode");
+          continue;
+        }
+
+        for (int n = 0; n < o.generations; ++n) {
+          ca.next();
+          resumed.next();
+        }
+        if (
+          resumed.generation_count() != ca.generation_count() ||
+          resumed.get_packed().words != ca.get_packed().words ||
+          resumed.get_cycle().has_value() != ca.get_cycle().has_value()
+        ) {
+          fail(name + ": differs after resuming");
+          continue;
+        }
+
+        ca.init_random();
+        resumed.init_random();
+        if (resumed.get_packed().words != ca.get_packed().words) {
+          fail(name + ": draws different random rows");
+        }
+      }
+    }
+  }
+
+  std::remove(path.c_str());
+  report("checkpoint", runs, failures - before);
+}
+
+// rows written through the mapped sink read back the same, both while the
+// file is still being written and once it is closed
+static void check_mapped_rows(const options &o) {
+  const uint64_t before = failures;
+  const std::string path =
+    (std::filesystem::temp_directory_path() / "qca_check.qcr").string();
+  uint64_t runs = 0;
+
+  for (const int width : {1, 64, 100, 4096}) {
+    const std::string name = "mapped rows: width " + std::to_string(width);
+    runs++;
+
+    qca::elementary ca(width, 1, qca::wolfram(30), qca::boundary::periodic);
+    ca.seed(o.seed);
+    ca.init_random();
+
+    static constexpr int rows = 10000;
+    std::vector<qca::packed_generation> expected;
+    qca::mapped_row_writer writer(path, width);
+    for (int n = 0; n < rows; ++n) {
+      expected.push_back(ca.get_packed());
+      writer.push(expected.back());
+      ca.next();
+    }
+
+    const auto same = [&](qca::mapped_row_reader &reader, const uint64_t n) {
+      if (!reader.good() || reader.width() != width || reader.size() != n) {
+        return false;
+      }
+      for (uint64_t i = 0; i < n; ++i) {
+        if (reader.at(i).words != expected[i].words) { return false; }
+      }
+      return true;
+    };
+
+    // unfinished: the rows published so far, which a run this long has some
+    // of, then all of them after a flush
+    qca::mapped_row_reader reader(path);
+    const uint64_t published = reader.size();
+    if (published == 0 || published > rows || !same(reader, published)) {
+      fail(name + ": unfinished file reads back wrong");
+      continue;
+    }
+    writer.flush();
+    reader.refresh();
+    if (!same(reader, rows)) {
+      fail(name + ": flushed file reads back wrong");
+      continue;
+    }
+
+    writer.close();
+    qca::mapped_row_reader closed(path);
+    if (!writer.good() || !same(closed, rows)) {
+      fail(name + ": closed file reads back wrong");
+    }
+  }
+
+  std::remove(path.c_str());
+  report("mapped rows", runs, failures - before);
+}
+
+// the engine with its row replaced by g
+static qca::elementary with_row(
+  const qca::generation &g, const uint8_t code, const qca::boundary b
+) {
+  qca::elementary ca(g.size(), 1, qca::wolfram(code), b);
+  qca::elementary_state state = ca.get_state();
+  state.row = qca::pack(g).words;
+  ca.set_state(state);
+
+  return ca;
+}
+
+// hashlife runs on an unbounded line, the packed engine on a field wide
+// enough that the cells in the middle never see its edges. after t
+// generations the cells t or more in from either edge depend only on the
+// first row, which both engines start from.
+static void check_hashlife(const options &o) {
+  const uint64_t before = failures;
+  uint64_t runs = 0;
+
+  static constexpr int levels = 10;
+  static constexpr int seed_width = 64;
+  static constexpr int width = seed_width + 4 * (1 << levels);
+
+  std::mt19937 engine(o.seed);
+  qca::generation first(width, 0);
+  for (int i = 0; i < seed_width; ++i) {
+    first[(width - seed_width) / 2 + i] = engine() & 1;
+  }
+
+  for (int code = 0; code < 256; ++code) {
+    qca::elementary ca = with_row(first, code, qca::boundary::zero);
+    qca::hashlife life(qca::wolfram(code));
+    life.init(first);
+    runs++;
+
+    for (int k = 0; k <= levels; ++k) {
+      const uint64_t t = uint64_t{1} << k;
+      while (ca.generation_count() < t) { ca.next(); }
+
+      const qca::generation all = ca.get();
+      const qca::generation expected(all.begin() + t, all.end() - t);
+      if (life.read_row(t, t, width - 2 * t) != expected) {
+        fail(
+          "hashlife: rule " + std::to_string(code) + " differs at generation " +
+          std::to_string(t)
+        );
+        break;
+      }
+    }
+  }
+
+  report("hashlife", runs, failures - before);
+}
+
+// every lane of the sweep is its own code's run of the packed engine, and
+// the densities and activities it counts are that run's
+static void check_rule_sweep(const options &o) {
+  const uint64_t before = failures;
+  uint64_t runs = 0;
+
+  for (const int width : {1, 2, 63, 64, 65, 200, 1000}) {
+    for (const qca::boundary b : boundaries) {
+      qca::elementary first(width, 1, qca::wolfram(0), b);
+      first.seed(o.seed + width);
+      first.init_random();
+      const qca::generation g = first.get();
+
+      qca::rule_sweep sweep(g, b);
+      std::vector<qca::elementary> runs_of(256);
+      for (int code = 0; code < 256; ++code) {
+        runs_of[code] = with_row(g, code, b);
+      }
+
+      std::vector<bool> failed(256, false);
+      for (int n = 1; n <= o.generations; ++n) {
+        sweep.next();
+        const std::array<double, 256> density = sweep.density();
+        const std::array<double, 256> activity = sweep.activity();
+
+        for (int code = 0; code < 256; ++code) {
+          if (failed[code]) { continue; }
+
+          const qca::generation was = runs_of[code].get();
+          runs_of[code].next();
+          const qca::generation is = runs_of[code].get();
+
+          int set = 0;
+          int changed = 0;
+          for (int i = 0; i < width; ++i) {
+            set += is[i];
+            changed += is[i] != was[i];
+          }
+
+          if (
+            sweep.packed_row(code).words != runs_of[code].get_packed().words ||
+            density[code] != double(set) / width ||
+            activity[code] != double(changed) / width
+          ) {
+            fail(
+              "rule sweep: rule " + std::to_string(code) + ", width " +
+              std::to_string(width) + ", " + qca::boundary_name(b) +
+              ": differs at generation " + std::to_string(n)
+            );
+            failed[code] = true;
+          }
+        }
+      }
+      runs += 256;
+    }
+  }
+
+  report("rule sweep", runs, failures - before);
+}
+
+// every member of an ensemble is its own run of the packed engine from the
+// same row, and freezes on the generation that run first repeats itself
+static void check_ensemble(const options &o) {
+  const uint64_t before = failures;
+  uint64_t runs = 0;
+  static constexpr int members = 128;
+
+  for (const int width : {1, 5, 64, 100}) {
+    std::vector<qca::elementary> runs_of(
+      members, qca::elementary(width, 1, qca::wolfram(0))
+    );
+
+    for (const qca::boundary b : boundaries) {
+      for (int code = 0; code < 256; ++code) {
+        qca::ensemble e(width, qca::wolfram(code), members, b);
+        for (int m = 0; m < members; ++m) {
+          qca::elementary &ca = runs_of[m];
+          ca.set_rules(qca::wolfram(code));
+          ca.set_boundary(b);
+          ca.seed(o.seed + m);
+          ca.init_random();
+          e.set_member(m, ca.get());
+        }
+
+        std::vector<int64_t> frozen(members, -1);
+        bool same = true;
+        for (int n = 0; n < 4 * o.generations && same; ++n) {
+          e.next();
+          for (int m = 0; m < members; ++m) {
+            const qca::packed_generation was = runs_of[m].get_packed();
+            runs_of[m].next();
+            const qca::packed_generation is = runs_of[m].get_packed();
+            if (frozen[m] < 0 && is.words == was.words) { frozen[m] = n; }
+
+            same = same && e.packed_member(m).words == is.words;
+          }
+          same = same && e.frozen_at() == frozen;
+        }
+
+        if (!same) {
+          fail(
+            "ensemble: rule " + std::to_string(code) + ", width " +
+            std::to_string(width) + ", " + qca::boundary_name(b) +
+            ": a member or its freezing differs"
+          );
+        }
+        runs++;
+      }
+    }
+  }
+
+  report("ensemble", runs, failures - before);
+}
+
+// cells and columns from the backward light cone are the ones next() gets
+// to stepping the whole row, including where the cone meets the edges
+static void check_light_cone(const options &o) {
+  const uint64_t before = failures;
+  uint64_t runs = 0;
+  const int n = 4 * o.generations;
+
+  for (const int width : {1, 5, 64, 100, 200}) {
+    for (const qca::boundary b : boundaries) {
+      for (int code = 0; code < 256; ++code) {
+        qca::elementary ca(width, 1, qca::wolfram(code), b);
+        ca.seed(o.seed + width);
+        ca.init_random();
+
+        std::vector<qca::generation> rows;
+        qca::elementary stepped = ca;
+        for (int t = 0; t < n; ++t) {
+          rows.push_back(stepped.get());
+          stepped.next();
+        }
+
+        bool same = true;
+        for (const int x : {0, width / 3, width / 2, width - 1}) {
+          const std::vector<uint8_t> column = ca.column(x, n);
+          for (int t = 0; t < n && same; ++t) {
+            same = column[t] == rows[t][x] && ca.cell_at(x, t) == rows[t][x];
+          }
+        }
+
+        if (!same) {
+          fail(
+            "light cone: rule " + std::to_string(code) + ", width " +
+            std::to_string(width) + ", " + qca::boundary_name(b) +
+            ": differs from next()"
+          );
+        }
+        runs++;
+      }
+    }
+  }
+
+  report("light cone", runs, failures - before);
+}
+
+// a history kept under a cap small enough to evict and thin gives back
+// every row of the run, and stays under the cap while it recomputes them
+static void check_history(const options &o) {
+  const uint64_t before = failures;
+  uint64_t runs = 0;
+  static constexpr int rows = 3000;
+
+  for (const int width : {1, 64, 100, 1000}) {
+    for (const qca::boundary b : boundaries) {
+      for (const int code : {30, 90, 110, 184}) {
+        qca::elementary ca(width, 1, qca::wolfram(code), b);
+        ca.seed(o.seed + width);
+        ca.init_random();
+
+        const std::size_t cap = 64 * ((width + 63) / 64 + 2) * 8;
+        qca::history_store history(width, code, b, cap, 4);
+        std::vector<qca::packed_generation> expected;
+        for (int n = 0; n < rows; ++n) {
+          expected.push_back(ca.get_packed());
+          history.push(expected.back());
+          ca.next();
+        }
+
+        bool same = history.size() == rows;
+        for (int n = 0; n < rows && same; ++n) {
+          same = history.at(n).words == expected[n].words;
+        }
+
+        if (!same || history.memory_used() > history.memory_cap()) {
+          fail(
+            "history: rule " + std::to_string(code) + ", width " +
+            std::to_string(width) + ", " + qca::boundary_name(b) +
+            (same ? ": over its cap" : ": differs from the run")
+          );
+        }
+        runs++;
+      }
+    }
+  }
+
+  report("history", runs, failures - before);
+}
+
+int main(int argc, const char *argv[]) {
+  const std::optional<options> o = parse_options(argc, argv);
+  if (!o) {
+    usage(argv[0]);
+    return to_underlying(error_code_t::invalid_arg);
+  }
+
+  std::cout << "Kernel: " << qca::isa_name(qca::active_isa()) << "\n";
+  std::cout << "Threads: " << o->threads << "\n";
+
+  using check = void (*)(const options &);
+  const std::pair<const char *, check> checks[] = {
+    {"step", check_step},
+    {"checkpoint", check_checkpoint},
+    {"history", check_history},
+    {"mapped rows", check_mapped_rows},
+    {"light cone", check_light_cone},
+    {"hashlife", check_hashlife},
+    {"rule sweep", check_rule_sweep},
+    {"ensemble", check_ensemble},
+  };
+  for (const auto &[name, run] : checks) {
+    if (std::string_view(name).find(o->filter) != std::string_view::npos) {
+      run(*o);
+    }
+  }
+
+  return failures ? to_underlying(error_code_t::check_failed) : 0;
+}
@@ -0,0 +1,285 @@
+#include <algorithm>
+#include <atomic>
+#include <charconv>
+#include <cstddef>
+#include <cstdint>
+#include <filesystem>
+#include <iostream>
+#include <map>
+#include <optional>
+#include <sstream>
+#include <string>
+#include <string_view>
+#include <thread>
+#include <vector>
+
+#define STB_IMAGE_WRITE_IMPLEMENTATION
+#include "stb_image_write.h"
+
+#include "archive.hpp"
+#include "boundary.hpp"
+#include "elementary.hpp"
+#include "util/error.hpp"
+#include "util/thread_pool.hpp"
+
+// headless renderer: runs every wolfram code (or a list of them) from the
+// same initial row, writes one png per rule and a contact sheet of them all.
+// each rule draws straight into its tile of the sheet, so the individual
+// pngs are written from the sheet with its stride and nothing is copied.
+// with -a each rule's rows are also kept in an archive next to its png.
+// when the first row is its own mirror image or complement, rules that are
+// mirrored or complemented versions of each other are drawn from one run.
+
+static constexpr int tile_gap = 4;
+static constexpr uint8_t gap_grey = 128;
+
+struct options {
+  // odd, so the single cell sits in the middle and mirrored rules fold
+  int width = 255;
+  int height = 128;
+  qca::init_mode init = qca::init_mode::single_1;
+  qca::boundary boundary = qca::boundary::zero;
+  uint32_t seed = 0;
+  std::vector<uint8_t> codes;
+  int columns = 16;
+  int threads = 0;
+  bool archive = false;
+  std::string out = "out/rules";
+};
+
+static void usage(const char *name) {
+  std::cerr << "usage: " << name << " [options]\n"
+    << "  -w WIDTH      cells per row (255)\n"
+    << "  -h HEIGHT     generations (128)\n"
+    << "  -i INIT       single_0, single_1, alternate or random (single_1)\n"
+    << "  -b BOUNDARY   zero, one, periodic or reflect (zero)\n"
+    << "  -s SEED       seed for random rows, shared by every rule (0)\n"
+    << "  -r CODES      comma separated wolfram codes (all 256)\n"
+    << "  -c COLUMNS    tiles per row of the contact sheet (16)\n"
+    << "  -j THREADS    worker threads (one per core)\n"
+    << "  -o DIR        output directory (out/rules)\n"
+    << "  -a            also write an archive of each rule's rows\n"
+    << "mirrored rules share a run only when the first row is its own mirror\n"
+    << "image, which a single cell is at odd widths, and complemented ones\n"
+    << "only when it is its own complement under the boundary.\n";
+}
+
+static std::optional<int> parse_int(const std::string_view s) {
+  int n = 0;
+  const auto [end, error] = std::from_chars(s.data(), s.data() + s.size(), n);
+  if (error != std::errc{} || end != s.data() + s.size()) {
+    return std::nullopt;
+  }
+
+  return n;
+}
+
+static std::optional<std::vector<uint8_t>> parse_codes(std::string_view s) {
+  std::vector<uint8_t> codes;
+
+  while (!s.empty()) {
+    const std::size_t comma = s.find(',');
+    const auto code = parse_int(s.substr(0, comma));
+    if (!code || *code < 0 || *code > 255) { return std::nullopt; }
+
+    codes.push_back(*code);
+    s = (comma == std::string_view::npos) ? "" : s.substr(comma + 1);
+  }
+
+  return codes;
+}
+
+static std::optional<options> parse_options(
+  const int argc, const char *argv[]
+) {
+  options o;
+
+  for (int i = 1; i < argc; ++i) {
+    const std::string_view flag = argv[i];
+    if (flag == "-a") {
+      o.archive = true;
+      continue;
+    }
+
+    if (++i >= argc) { return std::nullopt; }
+    const std::string_view value = argv[i];
+
+    std::optional<int> n;
+    if (flag == "-w" || flag == "-h" || flag == "-c" || flag == "-j") {
+      n = parse_int(value);
+      if (!n || *n < (flag == "-j" ? 0 : 1)) { return std::nullopt; }
+    }
+
+    if (flag == "-w") {
+      o.width = *n;
+    } else if (flag == "-h") {
+      o.height = *n;
+    } else if (flag == "-c") {
+      o.columns = *n;
+    } else if (flag == "-j") {
+      o.threads = *n;
+    } else if (flag == "-i") {
+      const auto m = qca::parse_init_mode(value);
+      if (!m) { return std::nullopt; }
+      o.init = *m;
+    } else if (flag == "-b") {
+      const auto b = qca::parse_boundary(value);
+      if (!b) { return std::nullopt; }
+      o.boundary = *b;
+    } else if (flag == "-s") {
+      const auto s = parse_int(value);
+      if (!s) { return std::nullopt; }
+      o.seed = *s;
+    } else if (flag == "-r") {
+      const auto codes = parse_codes(value);
+      if (!codes || codes->empty()) { return std::nullopt; }
+      o.codes = *codes;
+    } else if (flag == "-o") {
+      o.out = value;
+    } else {
+      return std::nullopt;
+    }
+  }
+
+  if (o.codes.empty()) {
+    for (int c = 0; c < 256; ++c) {
+      o.codes.push_back(c);
+    }
+  }
+  if (o.threads == 0) {
+    o.threads = std::max(1u, std::thread::hardware_concurrency());
+  }
+
+  return o;
+}
+
+int main(int argc, const char *argv[]) {
+  const std::optional<options> o = parse_options(argc, argv);
+  if (!o) {
+    usage(argv[0]);
+    return to_underlying(error_code_t::invalid_arg);
+  }
+
+  std::error_code error;
+  std::filesystem::create_directories(o->out, error);
+  if (error) {
+    std::cerr << "cannot create " << o->out << ": " << error.message() << "\n";
+    return to_underlying(error_code_t::write_failed);
+  }
+
+  const int count = o->codes.size();
+  const int columns = std::min(o->columns, count);
+  const int rows = (count + columns - 1) / columns;
+
+  const std::size_t sheet_width = columns * (o->width + tile_gap) - tile_gap;
+  const std::size_t sheet_height = rows * (o->height + tile_gap) - tile_gap;
+  const std::size_t stride = sheet_width * 3;
+  std::vector<uint8_t> sheet(stride * sheet_height, gap_grey);
+
+  // every rule starts from the same row, each tile is drawn from the run of
+  // the smallest code equivalent to its own from that row
+  qca::elementary first(o->width, o->height, qca::wolfram(0), o->boundary);
+  first.seed(o->seed);
+  first.init(o->init);
+  const qca::packed_generation start = first.get_packed();
+
+  struct member {
+    int tile;
+    qca::symmetry from;
+  };
+
+  std::map<uint8_t, std::vector<member>> classes;
+  for (int t = 0; t < count; ++t) {
+    const qca::equivalent e = qca::canonical(o->codes[t], start, o->boundary);
+    classes[e.code].push_back({t, e.from});
+  }
+  const std::vector<std::pair<uint8_t, std::vector<member>>> runs(
+    classes.begin(), classes.end()
+  );
+  const int run_count = runs.size();
+
+  // runs are handed out one at a time, as some take far longer to render
+  // (and compress) than others
+  std::atomic<int> next_run{0};
+  std::atomic<int> failed{0};
+  threading::Pool pool(o->threads);
+
+  pool.run([&](const std::size_t, const std::size_t) {
+    for (int n = next_run++; n < run_count; n = next_run++) {
+      const auto &[code, members] = runs[n];
+
+      qca::elementary ca(
+        o->width, o->height, qca::wolfram(code), o->boundary
+      );
+      ca.seed(o->seed);
+      ca.init(o->init);
+
+      std::vector<uint8_t *> tiles;
+      std::vector<std::string> paths;
+      std::vector<std::optional<qca::archive_writer>> archives(members.size());
+
+      for (std::size_t m = 0; m < members.size(); ++m) {
+        const int t = members[m].tile;
+        const std::size_t x = (t % columns) * (o->width + tile_gap);
+        const std::size_t y = (t / columns) * (o->height + tile_gap);
+        tiles.push_back(sheet.data() + y * stride + x * 3);
+
+        const uint8_t own = o->codes[t];
+        std::stringstream path;
+        path << o->out << "/rule_" << int(own);
+        paths.push_back(path.str());
+
+        if (o->archive) {
+          archives[m].emplace(
+            paths[m] + ".qca",
+            qca::archive_info{o->width, own, o->boundary, o->init, o->seed}
+          );
+        }
+      }
+
+      for (int g = 0; g < o->height; ++g) {
+        const qca::packed_generation row = ca.get_packed();
+
+        for (std::size_t m = 0; m < members.size(); ++m) {
+          const qca::symmetry s = members[m].from;
+          const qca::packed_generation own = (s.mirror || s.complement)
+            ? qca::transform(row, s) : row;
+
+          qca::cells_to_colour(own, ca.get_palette(), tiles[m] + g * stride);
+          if (archives[m]) {
+            archives[m]->push(own);
+          }
+        }
+        ca.next();
+      }
+
+      for (std::size_t m = 0; m < members.size(); ++m) {
+        if (archives[m] && !archives[m]->finish()) {
+          failed++;
+        }
+        if (!stbi_write_png(
+          (paths[m] + ".png").c_str(), o->width, o->height, 3, tiles[m],
+          stride
+        )) {
+          failed++;
+        }
+      }
+    }
+  });
+
+  const std::string atlas = o->out + "/atlas.png";
+  if (!stbi_write_png(
+    atlas.c_str(), sheet_width, sheet_height, 3, sheet.data(), stride
+  )) {
+    failed++;
+  }
+
+  if (failed > 0) {
+    std::cerr << failed << " files could not be written\n";
+    return to_underlying(error_code_t::write_failed);
+  }
+
+  std::cout << "Wrote " << count << " rules from " << run_count
+    << " runs and " << atlas << "\n";
+  return 0;
+}